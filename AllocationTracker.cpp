@@ -0,0 +1,99 @@
+#include "AllocationTracker.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+AllocationCounters AllocationCounters::since(const AllocationCounters& earlier) const {
+    return AllocationCounters{ allocations - earlier.allocations, bytes - earlier.bytes, liveBytes - earlier.liveBytes };
+}
+
+#ifdef ALLOCATION_TRACKING
+
+namespace {
+
+std::atomic<size_t> allocationCount{ 0 };
+std::atomic<size_t> allocatedBytes{ 0 };
+std::atomic<size_t> liveBytes{ 0 };
+
+// Every block starts with its size, so deleting it knows how many bytes are freed.
+// The header keeps the alignment malloc guarantees.
+constexpr size_t headerSize = alignof(std::max_align_t);
+
+void* allocate(size_t size) {
+    void* block = std::malloc(size + headerSize);
+    if (!block) {
+        return nullptr;
+    }
+    *static_cast<size_t*>(block) = size;
+
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    liveBytes.fetch_add(size, std::memory_order_relaxed);
+    return static_cast<char*>(block) + headerSize;
+}
+
+void deallocate(void* pointer) {
+    if (!pointer) {
+        return;
+    }
+    void* block = static_cast<char*>(pointer) - headerSize;
+    liveBytes.fetch_sub(*static_cast<size_t*>(block), std::memory_order_relaxed);
+    std::free(block);
+}
+
+}
+
+AllocationCounters AllocationTracker::getCounters() {
+    return AllocationCounters{ allocationCount.load(), allocatedBytes.load(), liveBytes.load() };
+}
+
+void* operator new(size_t size) {
+    if (void* pointer = allocate(size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    deallocate(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    deallocate(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    deallocate(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    deallocate(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    deallocate(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    deallocate(pointer);
+}
+
+#else
+
+AllocationCounters AllocationTracker::getCounters() {
+    return AllocationCounters{};
+}
+
+#endif
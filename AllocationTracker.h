@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+// Heap allocations counted by the global operator new, since the start of the program
+struct AllocationCounters {
+    size_t allocations = 0;
+    size_t bytes = 0;      // requested by all allocations
+    size_t liveBytes = 0;  // allocated and not yet freed
+
+    // Allocations made between earlier and these counters, liveBytes is the growth in between
+    AllocationCounters since(const AllocationCounters& earlier) const;
+};
+
+// Replaces the global operator new and delete when ALLOCATION_TRACKING is defined,
+// otherwise allocations are not counted and the counters stay zero.
+class AllocationTracker {
+public:
+#ifdef ALLOCATION_TRACKING
+    static constexpr bool enabled = true;
+#else
+    static constexpr bool enabled = false;
+#endif
+
+    static AllocationCounters getCounters();
+};
@@ -1,6 +1,7 @@
 #include "CellAddress.h"
 #include <stdexcept>
 #include <cctype>
+#include <limits>
 
 CellAddress CellAddress::fromString(const std::string& str) {
     size_t i = 0;
@@ -17,18 +18,38 @@ CellAddress CellAddress::fromString(const std::string& str) {
     std::string rowStr = str.substr(0, i);
     std::string colStr = str.substr(i);
 
+    // Indices that don't fit, or column 0, would wrap around when converted to 0-based
+    const size_t maxIndex = std::numeric_limits<size_t>::max();
+
     // Convert row (letters) to 0-based index
     size_t row = 0;
     for (char ch : rowStr) {
-        if (!std::isalpha(ch)) {
+        if (!std::isalpha(static_cast<unsigned char>(ch))) {
             throw std::invalid_argument("Invalid row characters in: " + str);
         }
-        row = row * 26 + (std::toupper(ch) - 'A' + 1);
+        if (row > (maxIndex - 26) / 26) {
+            throw std::out_of_range("Cell address out of range: " + str);
+        }
+        row = row * 26 + (std::toupper(static_cast<unsigned char>(ch)) - 'A' + 1);
     }
     row -= 1; // Convert to 0-based
 
     // Convert column (number) to 0-based index
-    size_t column = std::stoul(colStr) - 1;
+    size_t column = 0;
+    for (char ch : colStr) {
+        if (!std::isdigit(static_cast<unsigned char>(ch))) {
+            throw std::invalid_argument("Invalid column digits in: " + str);
+        }
+        size_t digit = static_cast<size_t>(ch - '0');
+        if (column > (maxIndex - digit) / 10) {
+            throw std::out_of_range("Cell address out of range: " + str);
+        }
+        column = column * 10 + digit;
+    }
+    if (column == 0) {
+        throw std::out_of_range("Cell address out of range: " + str);
+    }
+    column -= 1; // Convert to 0-based
 
     return CellAddress{ row, column };
 }
@@ -46,6 +67,18 @@ std::string CellAddress::toString() const {
     return rowStr + std::to_string(column + 1); // Convert back to 1-based
 }
 
+CellAddress CellAddress::offsetBy(long long rowOffset, long long columnOffset) const {
+    long long newRow = static_cast<long long>(row) + rowOffset;
+    long long newColumn = static_cast<long long>(column) + columnOffset;
+
+    if (newRow < 0 || newColumn < 0) {
+        throw std::invalid_argument("Cell address out of range: " + toString() + " shifted by R[" +
+            std::to_string(rowOffset) + "]C[" + std::to_string(columnOffset) + "]");
+    }
+
+    return CellAddress{ static_cast<size_t>(newRow), static_cast<size_t>(newColumn) };
+}
+
 bool CellAddress::operator==(const CellAddress& other) const {
     return this->row == other.row && this->column == other.column;
 }
\ No newline at end of file
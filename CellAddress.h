@@ -10,6 +10,9 @@ struct CellAddress {
     static CellAddress fromString(const std::string& str);
     std::string toString() const;
 
+    // Address shifted by the given (possibly negative) number of rows and columns
+    CellAddress offsetBy(long long rowOffset, long long columnOffset) const;
+
     bool operator==(const CellAddress& other) const;
 };
 
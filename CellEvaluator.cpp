@@ -5,7 +5,8 @@
 #include <limits>
 #include <variant>
 
-CellEvaluator::CellEvaluator(const TableModel& model) : model(model) {}
+CellEvaluator::CellEvaluator(const TableModel& model, size_t cacheSize, const SheetResolver* sheets)
+    : model(model), cacheSize(cacheSize), sheets(sheets) {}
 
 // - HELPERS
 
@@ -25,6 +26,10 @@ std::string getStringValue(const LiteralValue& lv) {
     }
 }
 
+static bool isRangeParam(const FormulaParam& param) {
+    return std::holds_alternative<AddressRange>(param) || std::holds_alternative<SheetRange>(param);
+}
+
 double getNumericValue(const LiteralValue& lv) {
     if (auto val = std::get_if<bool>(&lv.value)) {
         return (*val) ? 1.0 : 0.0;
@@ -58,6 +63,26 @@ std::string CellEvaluator::evaluate(const CellValue& cellValue) {
     }
 }
 
+std::string CellEvaluator::evaluate(const CellAddress& address, const CellValue& cellValue) {
+    try {
+        LiteralValue result = resolveCell(address, cellValue);
+        return getStringValue(result);
+    }
+    catch (const std::runtime_error& e) {
+        return e.what();
+    }
+    catch (const std::invalid_argument& e) {
+        return e.what();
+    }
+    catch (...) {
+        return "#ERROR!";
+    }
+}
+
+const EvaluationProfile& CellEvaluator::getProfile() const {
+    return profiler.getProfile();
+}
+
 // - Private evaluation
 
 LiteralValue CellEvaluator::resolve(const CellValue& value) {
@@ -73,17 +98,84 @@ LiteralValue CellEvaluator::resolve(const CellValue& value) {
             return LiteralValue{ "#REF!" };
         }
         // Recursive call to resolve the referenced cell's value
-        return resolve(*targetCellValue);
+        return resolveCell(targetAddress, *targetCellValue);
     }
     else if (value.isFormula()) {
         const FormulaValue& formula = std::get<FormulaValue>(value.value);
         return evaluateFormula(formula);
     }
+    else if (value.isSheetReference()) {
+        return resolveSheetCell(std::get<SheetAddress>(value.value)).value_or(LiteralValue{ "#REF!" });
+    }
 
     // Should never come here
     return LiteralValue{ "#VALUE!" };
 }
 
+LiteralValue CellEvaluator::resolveCell(const CellAddress& address, const CellValue& value) {
+    profiler.cellTouched();
+
+    if (cacheSize == 0) {
+        return resolveProfiled(address, value);
+    }
+
+    auto cached = cache.find(address);
+    if (cached != cache.end()) {
+        profiler.cacheHit();
+        return cached->second;
+    }
+    profiler.cacheMiss();
+
+    LiteralValue result = resolveProfiled(address, value);
+
+    // Starting over keeps the memory bounded, cells evaluated afterwards are still cached
+    if (cache.size() >= cacheSize) {
+        cache.clear();
+    }
+    cache.emplace(address, result);
+    return result;
+}
+
+// Formula cells are profiled on their own, literals and references count towards the formula reading them
+LiteralValue CellEvaluator::resolveProfiled(const CellAddress& address, const CellValue& value) {
+    if (!EvaluationProfiler::enabled || !value.isFormula()) {
+        return resolve(value);
+    }
+
+    profiler.cellEntered();
+    LiteralValue result = resolve(value);
+    profiler.cellLeft(address, std::get<FormulaValue>(value.value).type);
+    return result;
+}
+
+// - Other sheets
+
+CellEvaluator* CellEvaluator::evaluatorFor(const std::string& sheet) {
+    auto it = sheetEvaluators.find(sheet);
+    if (it == sheetEvaluators.end()) {
+        const TableModel* sheetModel = sheets ? sheets->findSheet(sheet) : nullptr;
+        if (!sheetModel) {
+            return nullptr;
+        }
+        it = sheetEvaluators.emplace(sheet, std::make_unique<CellEvaluator>(*sheetModel, cacheSize, sheets)).first;
+    }
+    return it->second.get();
+}
+
+// Value of a cell on another sheet, nullopt when the cell is empty. Unknown sheets are #REF!.
+std::optional<LiteralValue> CellEvaluator::resolveSheetCell(const SheetAddress& address) {
+    CellEvaluator* evaluator = evaluatorFor(address.sheet);
+    if (!evaluator) {
+        return LiteralValue{ "#REF!" };
+    }
+
+    const CellValue* cellValue = evaluator->model.getCellValue(address.address);
+    if (!cellValue) {
+        return std::nullopt;
+    }
+    return evaluator->resolveCell(address.address, *cellValue);
+}
+
 // - Formula Evaluation Helpers
 
 LiteralValue CellEvaluator::evaluateFormula(const FormulaValue& formula) {
@@ -143,7 +235,7 @@ std::vector<LiteralValue> CellEvaluator::flattenArgs(const std::vector<FormulaPa
         else if (auto val = std::get_if<CellAddress>(&param)) {
             const CellValue* cellValue = model.getCellValue(*val);
             if (cellValue) {
-                flattened.push_back(resolve(*cellValue));
+                flattened.push_back(resolveCell(*val, *cellValue));
             }
             else {
                 // Per requirements, empty cell evaluates to 0 for numeric context, or empty string for others
@@ -151,8 +243,11 @@ std::vector<LiteralValue> CellEvaluator::flattenArgs(const std::vector<FormulaPa
                 flattened.push_back(LiteralValue{ "" });
             }
         }
-        else if (auto val = std::get_if<AddressRange>(&param)) {
-            std::vector<LiteralValue> rangeValues = expandRange(*val);
+        else if (auto val = std::get_if<SheetAddress>(&param)) {
+            flattened.push_back(resolveSheetCell(*val).value_or(LiteralValue{ "" }));
+        }
+        else if (isRangeParam(param)) {
+            std::vector<LiteralValue> rangeValues = expandRangeParam(param);
             flattened.insert(flattened.end(), rangeValues.begin(), rangeValues.end());
         }
     }
@@ -179,7 +274,7 @@ std::vector<LiteralValue> CellEvaluator::expandRange(const AddressRange& range)
             CellAddress currentAddress{ r, c };
             const CellValue* cellValue = model.getCellValue(currentAddress);
             if (cellValue) {
-                expandedValues.push_back(resolve(*cellValue));
+                expandedValues.push_back(resolveCell(currentAddress, *cellValue));
             }
             else {
                 // If a cell in the range is empty, treat it as empty string.
@@ -191,6 +286,17 @@ std::vector<LiteralValue> CellEvaluator::expandRange(const AddressRange& range)
     return expandedValues;
 }
 
+std::vector<LiteralValue> CellEvaluator::expandRangeParam(const FormulaParam& param) {
+    if (auto val = std::get_if<SheetRange>(&param)) {
+        CellEvaluator* evaluator = evaluatorFor(val->sheet);
+        if (!evaluator) {
+            return { LiteralValue{ "#REF!" } };
+        }
+        return evaluator->expandRange(val->range);
+    }
+    return expandRange(std::get<AddressRange>(param));
+}
+
 // --- Formula Evaluation Functions ---
 
 LiteralValue CellEvaluator::evalSUM(const std::vector<FormulaParam>& args) {
@@ -249,11 +355,11 @@ LiteralValue CellEvaluator::evalAVERAGE(const std::vector<FormulaParam>& args) {
 
 LiteralValue CellEvaluator::evalMIN(const std::vector<FormulaParam>& args) {
     // Must accept exactly 1 argument, which must be a range
-    if (args.size() != 1 || !std::holds_alternative<AddressRange>(args[0])) {
+    if (args.size() != 1 || !isRangeParam(args[0])) {
         return LiteralValue{ "#VALUE!" };
     }
 
-    std::vector<LiteralValue> values = expandRange(std::get<AddressRange>(args[0]));
+    std::vector<LiteralValue> values = expandRangeParam(args[0]);
     if (containsErrorLiteral(values)) {
         return LiteralValue{ "#VALUE!" };
     }
@@ -277,11 +383,11 @@ LiteralValue CellEvaluator::evalMIN(const std::vector<FormulaParam>& args) {
 
 LiteralValue CellEvaluator::evalMAX(const std::vector<FormulaParam>& args) {
     // Must accept exactly 1 argument, which must be a range
-    if (args.size() != 1 || !std::holds_alternative<AddressRange>(args[0])) {
+    if (args.size() != 1 || !isRangeParam(args[0])) {
         return LiteralValue{ "#VALUE!" };
     }
 
-    std::vector<LiteralValue> values = expandRange(std::get<AddressRange>(args[0]));
+    std::vector<LiteralValue> values = expandRangeParam(args[0]);
     if (containsErrorLiteral(values)) {
         return LiteralValue{ "#VALUE!" };
     }
@@ -305,11 +411,11 @@ LiteralValue CellEvaluator::evalMAX(const std::vector<FormulaParam>& args) {
 
 LiteralValue CellEvaluator::evalCONCAT(const std::vector<FormulaParam>& args) {
     // Must have exactly 2 parameters: first a range, second a literal value (delimiter)
-    if (args.size() != 2 || !std::holds_alternative<AddressRange>(args[0]) || !std::holds_alternative<LiteralValue>(args[1])) {
+    if (args.size() != 2 || !isRangeParam(args[0]) || !std::holds_alternative<LiteralValue>(args[1])) {
         return LiteralValue{ "#VALUE!" };
     }
 
-    std::vector<LiteralValue> rangeValues = expandRange(std::get<AddressRange>(args[0]));
+    std::vector<LiteralValue> rangeValues = expandRangeParam(args[0]);
     if (containsErrorLiteral(rangeValues)) {
         return LiteralValue{ "#VALUE!" };
     }
@@ -337,7 +443,7 @@ LiteralValue CellEvaluator::evalCONCAT(const std::vector<FormulaParam>& args) {
 
 LiteralValue CellEvaluator::evalSUBSTR(const std::vector<FormulaParam>& args) {
     // Must accept exactly 3 arguments: text, start, length. Text cannot be a range.
-    if (args.size() != 3 || std::holds_alternative<AddressRange>(args[0])) {
+    if (args.size() != 3 || isRangeParam(args[0])) {
         return LiteralValue{ "#VALUE!" };
     }
 
@@ -381,7 +487,7 @@ LiteralValue CellEvaluator::evalSUBSTR(const std::vector<FormulaParam>& args) {
 
 LiteralValue CellEvaluator::evalLEN(const std::vector<FormulaParam>& args) {
     // Must accept exactly 1 argument, and it cannot be a range
-    if (args.size() != 1 || std::holds_alternative<AddressRange>(args[0])) {
+    if (args.size() != 1 || isRangeParam(args[0])) {
         return LiteralValue{ "#VALUE!" };
     }
 
@@ -396,11 +502,11 @@ LiteralValue CellEvaluator::evalLEN(const std::vector<FormulaParam>& args) {
 
 LiteralValue CellEvaluator::evalCOUNT(const std::vector<FormulaParam>& args) {
     // Must accept exactly 1 argument, which must be a range
-    if (args.size() != 1 || !std::holds_alternative<AddressRange>(args[0])) {
+    if (args.size() != 1 || !isRangeParam(args[0])) {
         return LiteralValue{ "#VALUE!" };
     }
 
-    std::vector<LiteralValue> values = expandRange(std::get<AddressRange>(args[0]));
+    std::vector<LiteralValue> values = expandRangeParam(args[0]);
     if (containsErrorLiteral(values)) {
         return LiteralValue{ "#VALUE!" };
     }
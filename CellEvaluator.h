@@ -1,23 +1,54 @@
 #pragma once
 
+#include <memory>
+#include <optional>
 #include <vector>
 #include <string>
+#include <unordered_map>
 #include "CellAddress.h"
 #include "TableModel.h"
 #include "CellValue.h"
 #include "Event.h"
+#include "EvaluationProfiler.h"
+
+// The sheets of a workbook, for evaluating references to other sheets
+class SheetResolver {
+public:
+    virtual ~SheetResolver() = default;
+    // nullptr when the workbook has no sheet of that name
+    virtual const TableModel* findSheet(const std::string& name) const = 0;
+};
 
 class CellEvaluator {
 public:
-    CellEvaluator(const TableModel& model);
+    // Resolved cell values are memoized, up to cacheSize entries (0 disables the cache).
+    // The cache assumes the table does not change while the evaluator is in use.
+    // Without sheets, references to other sheets evaluate to #REF!.
+    CellEvaluator(const TableModel& model, size_t cacheSize = 0, const SheetResolver* sheets = nullptr);
 
     // Evaluate a single cell value in context
     std::string evaluate(const CellValue& cellValue);
+    // Evaluate the value of the cell at address, which is cached and profiled like the cells it references
+    std::string evaluate(const CellAddress& address, const CellValue& cellValue);
+
+    // Empty unless built with EVALUATION_PROFILING
+    const EvaluationProfile& getProfile() const;
 
 private:
     const TableModel& model;
-    
+    size_t cacheSize;
+    std::unordered_map<CellAddress, LiteralValue> cache;
+    EvaluationProfiler profiler;
+
+    // One evaluator per other sheet referenced so far, each caching the cells of its own sheet
+    const SheetResolver* sheets;
+    std::unordered_map<std::string, std::unique_ptr<CellEvaluator>> sheetEvaluators;
+
     LiteralValue resolve(const CellValue& value);
+    LiteralValue resolveCell(const CellAddress& address, const CellValue& value);
+    LiteralValue resolveProfiled(const CellAddress& address, const CellValue& value);
+    CellEvaluator* evaluatorFor(const std::string& sheet);
+    std::optional<LiteralValue> resolveSheetCell(const SheetAddress& address);
     LiteralValue evaluateFormula(const FormulaValue& formula);
     bool containsErrorLiteral(const std::vector<LiteralValue>& values);
 
@@ -32,4 +63,6 @@ private:
 
     std::vector<LiteralValue> flattenArgs(const std::vector<FormulaParam>& args);
     std::vector<LiteralValue> expandRange(const AddressRange& range);
+    // Values of an AddressRange or SheetRange parameter
+    std::vector<LiteralValue> expandRangeParam(const FormulaParam& param);
 };
\ No newline at end of file
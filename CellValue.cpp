@@ -11,3 +11,20 @@ bool CellValue::isReference() const {
 bool CellValue::isFormula() const {
     return std::holds_alternative<FormulaValue>(value);
 }
+
+bool CellValue::isSheetReference() const {
+    return std::holds_alternative<SheetAddress>(value);
+}
+
+CellValue CellValue::offsetBy(long long rowOffset, long long columnOffset) const {
+    if (auto val = std::get_if<CellAddress>(&value)) {
+        return CellValue{ val->offsetBy(rowOffset, columnOffset) };
+    }
+    else if (auto val = std::get_if<FormulaValue>(&value)) {
+        return CellValue{ val->offsetBy(rowOffset, columnOffset) };
+    }
+    else if (auto val = std::get_if<SheetAddress>(&value)) {
+        return CellValue{ SheetAddress{ val->sheet, val->address.offsetBy(rowOffset, columnOffset) } };
+    }
+    return *this;
+}
@@ -7,9 +7,14 @@
 #include "Event.h"
 
 struct CellValue {
-    std::variant<LiteralValue, CellAddress, FormulaValue> value;
+    std::variant<LiteralValue, CellAddress, FormulaValue, SheetAddress> value;
 
     bool isLiteral() const;
     bool isReference() const;
     bool isFormula() const;
+    // Reference to a cell of another sheet
+    bool isSheetReference() const;
+
+    // Copy of the value for a cell rowOffset/columnOffset away, with references shifted along
+    CellValue offsetBy(long long rowOffset, long long columnOffset) const;
 };
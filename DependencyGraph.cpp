@@ -0,0 +1,193 @@
+#include "DependencyGraph.h"
+#include <algorithm>
+
+void DependencyGraph::setCell(const CellAddress& address, const CellValue& value) {
+    removeCell(address);
+
+    Precedents cellPrecedents;
+    if (auto val = std::get_if<CellAddress>(&value.value)) {
+        cellPrecedents.cells.push_back(*val);
+    }
+    else if (auto val = std::get_if<SheetAddress>(&value.value)) {
+        cellPrecedents.sheetRanges.push_back(SheetRange{ val->sheet, AddressRange{ val->address, val->address } });
+    }
+    else if (auto val = std::get_if<FormulaValue>(&value.value)) {
+        for (const auto& param : val->parameters) {
+            if (auto cell = std::get_if<CellAddress>(&param)) {
+                cellPrecedents.cells.push_back(*cell);
+            }
+            else if (auto range = std::get_if<AddressRange>(&param)) {
+                cellPrecedents.ranges.push_back(normalize(*range));
+            }
+            else if (auto cell = std::get_if<SheetAddress>(&param)) {
+                cellPrecedents.sheetRanges.push_back(SheetRange{ cell->sheet, AddressRange{ cell->address, cell->address } });
+            }
+            else if (auto range = std::get_if<SheetRange>(&param)) {
+                cellPrecedents.sheetRanges.push_back(SheetRange{ range->sheet, normalize(range->range) });
+            }
+        }
+    }
+
+    if (cellPrecedents.cells.empty() && cellPrecedents.ranges.empty() && cellPrecedents.sheetRanges.empty()) {
+        return;
+    }
+
+    for (const auto& cell : cellPrecedents.cells) {
+        cellDependents[cell].push_back(address);
+    }
+    for (const auto& range : cellPrecedents.ranges) {
+        addRange(rangeDependents, range, address);
+    }
+    for (const auto& sheetRange : cellPrecedents.sheetRanges) {
+        addRange(sheetDependents[sheetRange.sheet], sheetRange.range, address);
+    }
+
+    precedents.emplace(address, std::move(cellPrecedents));
+}
+
+void DependencyGraph::removeCell(const CellAddress& address) {
+    auto it = precedents.find(address);
+    if (it == precedents.end()) {
+        return;
+    }
+
+    for (const auto& cell : it->second.cells) {
+        auto dependents = cellDependents.find(cell);
+        if (dependents == cellDependents.end()) continue;
+
+        auto& list = dependents->second;
+        list.erase(std::remove(list.begin(), list.end(), address), list.end());
+        if (list.empty()) {
+            cellDependents.erase(dependents);
+        }
+    }
+
+    for (const auto& range : it->second.ranges) {
+        removeRange(rangeDependents, range, address);
+    }
+
+    for (const auto& sheetRange : it->second.sheetRanges) {
+        auto index = sheetDependents.find(sheetRange.sheet);
+        if (index == sheetDependents.end()) continue;
+
+        removeRange(index->second, sheetRange.range, address);
+        if (index->second.empty()) {
+            sheetDependents.erase(index);
+        }
+    }
+
+    precedents.erase(it);
+}
+
+void DependencyGraph::clear() {
+    precedents.clear();
+    cellDependents.clear();
+    rangeDependents.clear();
+    sheetDependents.clear();
+}
+
+std::vector<CellAddress> DependencyGraph::collectAffected(const std::unordered_set<CellAddress>& changed) const {
+    std::unordered_set<CellAddress> visited(changed.begin(), changed.end());
+    std::vector<CellAddress> affected(changed.begin(), changed.end());
+    std::vector<CellAddress> dependents;
+
+    // Breadth-first over dependents; the visited set also stops on circular references
+    for (size_t i = 0; i < affected.size(); ++i) {
+        dependents.clear();
+        addDependents(affected[i], dependents);
+        for (const auto& dependent : dependents) {
+            if (visited.insert(dependent).second) {
+                affected.push_back(dependent);
+            }
+        }
+    }
+
+    return affected;
+}
+
+std::vector<CellAddress> DependencyGraph::collectSheetDependents(const std::string& sheet, const std::vector<CellAddress>& changed) const {
+    auto index = sheetDependents.find(sheet);
+    if (index == sheetDependents.end()) {
+        return {};
+    }
+
+    std::vector<CellAddress> dependents;
+    for (const auto& address : changed) {
+        addRangeDependents(index->second, address, dependents);
+    }
+
+    std::unordered_set<CellAddress> unique(dependents.begin(), dependents.end());
+    return std::vector<CellAddress>(unique.begin(), unique.end());
+}
+
+std::vector<CellAddress> DependencyGraph::collectSheetDependents(const std::string& sheet) const {
+    auto index = sheetDependents.find(sheet);
+    if (index == sheetDependents.end()) {
+        return {};
+    }
+
+    std::unordered_set<CellAddress> unique;
+    for (const auto& [block, list] : index->second) {
+        for (const auto& rd : list) {
+            unique.insert(rd.dependent);
+        }
+    }
+    return std::vector<CellAddress>(unique.begin(), unique.end());
+}
+
+void DependencyGraph::addDependents(const CellAddress& address, std::vector<CellAddress>& out) const {
+    auto cells = cellDependents.find(address);
+    if (cells != cellDependents.end()) {
+        out.insert(out.end(), cells->second.begin(), cells->second.end());
+    }
+
+    addRangeDependents(rangeDependents, address, out);
+}
+
+void DependencyGraph::addRange(RangeIndex& index, const AddressRange& range, const CellAddress& dependent) {
+    for (size_t block = range.start.row / rangeBlockRows; block <= range.end.row / rangeBlockRows; ++block) {
+        for (size_t column = range.start.column; column <= range.end.column; ++column) {
+            index[CellAddress{ block, column }].push_back(RangeDependent{ range, dependent });
+        }
+    }
+}
+
+void DependencyGraph::removeRange(RangeIndex& index, const AddressRange& range, const CellAddress& dependent) {
+    for (size_t block = range.start.row / rangeBlockRows; block <= range.end.row / rangeBlockRows; ++block) {
+        for (size_t column = range.start.column; column <= range.end.column; ++column) {
+            auto dependents = index.find(CellAddress{ block, column });
+            if (dependents == index.end()) continue;
+
+            auto& list = dependents->second;
+            list.erase(std::remove_if(list.begin(), list.end(), [&dependent](const RangeDependent& rd) {
+                return rd.dependent == dependent;
+                }), list.end());
+            if (list.empty()) {
+                index.erase(dependents);
+            }
+        }
+    }
+}
+
+void DependencyGraph::addRangeDependents(const RangeIndex& index, const CellAddress& address, std::vector<CellAddress>& out) {
+    auto ranges = index.find(blockOf(address.row, address.column));
+    if (ranges != index.end()) {
+        for (const auto& rd : ranges->second) {
+            if (address.row >= rd.range.start.row && address.row <= rd.range.end.row &&
+                address.column >= rd.range.start.column && address.column <= rd.range.end.column) {
+                out.push_back(rd.dependent);
+            }
+        }
+    }
+}
+
+AddressRange DependencyGraph::normalize(const AddressRange& range) {
+    return AddressRange{
+        CellAddress{ std::min(range.start.row, range.end.row), std::min(range.start.column, range.end.column) },
+        CellAddress{ std::max(range.start.row, range.end.row), std::max(range.start.column, range.end.column) }
+    };
+}
+
+CellAddress DependencyGraph::blockOf(size_t row, size_t column) {
+    return CellAddress{ row / rangeBlockRows, column };
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "CellAddress.h"
+#include "CellValue.h"
+
+// Tracks which cells each reference and formula reads, so a change only recalculates the cells depending on it.
+// Edges are kept by address, whether or not the precedent cell currently exists.
+// Precedents on other sheets of a workbook are kept by sheet name, whether or not the sheet exists.
+class DependencyGraph {
+public:
+    void setCell(const CellAddress& address, const CellValue& value);
+    void removeCell(const CellAddress& address);
+    void clear();
+
+    // Cells whose value depends, directly or transitively, on any of the changed cells (those included)
+    std::vector<CellAddress> collectAffected(const std::unordered_set<CellAddress>& changed) const;
+
+    // Cells reading any of the changed cells of another sheet directly, or anything on it without changed
+    std::vector<CellAddress> collectSheetDependents(const std::string& sheet, const std::vector<CellAddress>& changed) const;
+    std::vector<CellAddress> collectSheetDependents(const std::string& sheet) const;
+
+private:
+    // Range precedents are indexed in blocks of rows per column, so lookups don't scan every range in the table
+    static constexpr size_t rangeBlockRows = 64;
+
+    struct Precedents {
+        std::vector<CellAddress> cells;
+        std::vector<AddressRange> ranges;
+        std::vector<SheetRange> sheetRanges; // cells on other sheets as one-cell ranges
+    };
+
+    struct RangeDependent {
+        AddressRange range;
+        CellAddress dependent;
+    };
+
+    // Dependents of the ranges overlapping each block
+    using RangeIndex = std::unordered_map<CellAddress, std::vector<RangeDependent>>;
+
+    std::unordered_map<CellAddress, Precedents> precedents;
+    std::unordered_map<CellAddress, std::vector<CellAddress>> cellDependents;
+    RangeIndex rangeDependents;
+    std::unordered_map<std::string, RangeIndex> sheetDependents;
+
+    void addDependents(const CellAddress& address, std::vector<CellAddress>& out) const;
+    static void addRange(RangeIndex& index, const AddressRange& range, const CellAddress& dependent);
+    static void removeRange(RangeIndex& index, const AddressRange& range, const CellAddress& dependent);
+    static void addRangeDependents(const RangeIndex& index, const CellAddress& address, std::vector<CellAddress>& out);
+    static AddressRange normalize(const AddressRange& range);
+    static CellAddress blockOf(size_t row, size_t column);
+};
@@ -1,11 +1,39 @@
 #include "DisplayableTableModel.h"
+#include "MemoryUsage.h"
 
 void DisplayableTableModel::setDisplayValue(const CellAddress& address, const std::string& value) {
-    displayValues[address] = value;
+    auto [it, inserted] = displayValues.try_emplace(address, value);
+    if (inserted) {
+        ++rowValueCounts[address.row];
+        ++columnValueCounts[address.column];
+        ++columnLengthCounts[address.column][value.length()];
+        return;
+    }
+
+    if (it->second.length() != value.length()) {
+        auto& lengthCounts = columnLengthCounts[address.column];
+        decrementCount(lengthCounts, it->second.length());
+        ++lengthCounts[value.length()];
+    }
+    it->second = value;
 }
 
 void DisplayableTableModel::removeDisplayValue(const CellAddress& address) {
-    displayValues.erase(address);
+    auto it = displayValues.find(address);
+    if (it == displayValues.end()) {
+        return;
+    }
+
+    decrementCount(rowValueCounts, address.row);
+    decrementCount(columnValueCounts, address.column);
+
+    auto lengthCounts = columnLengthCounts.find(address.column);
+    decrementCount(lengthCounts->second, it->second.length());
+    if (lengthCounts->second.empty()) {
+        columnLengthCounts.erase(lengthCounts);
+    }
+
+    displayValues.erase(it);
 }
 
 const std::string* DisplayableTableModel::getDisplayValue(const CellAddress& address) const {
@@ -18,17 +46,33 @@ const DisplayableTableModel::DisplayMap& DisplayableTableModel::getAllDisplayVal
 }
 
 size_t DisplayableTableModel::getRowCount() const {
-    size_t rowMax = 0;
-    for (const auto& val : displayValues) {
-        rowMax = std::max(rowMax, val.first.row);
-    }
-    return rowMax + 1;
+    return rowValueCounts.empty() ? 1 : rowValueCounts.rbegin()->first + 1;
 }
 
 size_t DisplayableTableModel::getColumnCount() const {
-    size_t colMax = 0;
-    for (const auto& val : displayValues) {
-        colMax = std::max(colMax, val.first.column);
+    return columnValueCounts.empty() ? 1 : columnValueCounts.rbegin()->first + 1;
+}
+
+size_t DisplayableTableModel::getMaxValueLength(size_t column) const {
+    auto it = columnLengthCounts.find(column);
+    return it == columnLengthCounts.end() ? 0 : it->second.rbegin()->first;
+}
+
+void DisplayableTableModel::decrementCount(std::map<size_t, size_t>& counts, size_t key) {
+    auto it = counts.find(key);
+    if (it != counts.end() && --it->second == 0) {
+        counts.erase(it);
     }
-    return colMax + 1;
-}
\ No newline at end of file
+}
+
+size_t DisplayableTableModel::estimateMemoryUsage() const {
+    size_t bytes = containerBytes(displayValues) + containerBytes(rowValueCounts) + containerBytes(columnValueCounts)
+        + containerBytes(columnLengthCounts);
+    for (const auto& [address, value] : displayValues) {
+        bytes += stringHeapBytes(value);
+    }
+    for (const auto& [column, lengthCounts] : columnLengthCounts) {
+        bytes += containerBytes(lengthCounts);
+    }
+    return bytes;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <unordered_map>
+#include <map>
 #include <string>
 #include "CellAddress.h"
 
@@ -16,6 +17,21 @@ public:
     size_t getRowCount() const;
     size_t getColumnCount() const;
 
+    // Length of the longest value in the column, 0 if it has none
+    size_t getMaxValueLength(size_t column) const;
+
+    // Estimated bytes of the values and the counts kept for them
+    size_t estimateMemoryUsage() const;
+
 private:
     DisplayMap displayValues;
+
+    // Number of values in each row and column, so the extent of the table is known without a scan
+    std::map<size_t, size_t> rowValueCounts;
+    std::map<size_t, size_t> columnValueCounts;
+
+    // Number of values of each length per column, so the longest is known and can shrink when it changes
+    std::unordered_map<size_t, std::map<size_t, size_t>> columnLengthCounts;
+
+    static void decrementCount(std::map<size_t, size_t>& counts, size_t key);
 };
\ No newline at end of file
@@ -0,0 +1,103 @@
+#include "EditHistory.h"
+
+EditHistory::EditHistory(size_t memoryLimit) : memoryLimit(memoryLimit) {}
+
+bool EditHistory::record(Edit edit) {
+    if (edit.empty()) {
+        return true;
+    }
+
+    // The edit changed the table either way, so what was undone can't be redone on top of it
+    for (const auto& redone : redoStack) {
+        memoryUsage -= estimateSize(redone);
+    }
+    redoStack.clear();
+
+    size_t size = estimateSize(edit);
+    if (size > memoryLimit) {
+        return false;
+    }
+
+    memoryUsage += size;
+    undoStack.push_back(std::move(edit));
+    enforceMemoryLimit();
+    return true;
+}
+
+const Edit* EditHistory::undo() {
+    if (undoStack.empty()) {
+        return nullptr;
+    }
+
+    redoStack.push_back(std::move(undoStack.back()));
+    undoStack.pop_back();
+    return &redoStack.back();
+}
+
+const Edit* EditHistory::redo() {
+    if (redoStack.empty()) {
+        return nullptr;
+    }
+
+    undoStack.push_back(std::move(redoStack.back()));
+    redoStack.pop_back();
+    return &undoStack.back();
+}
+
+void EditHistory::clear() {
+    undoStack.clear();
+    redoStack.clear();
+    memoryUsage = 0;
+}
+
+size_t EditHistory::getMemoryUsage() const {
+    return memoryUsage;
+}
+
+void EditHistory::enforceMemoryLimit() {
+    // The latest edit fits on its own, so it is never dropped here
+    while (memoryUsage > memoryLimit && !undoStack.empty()) {
+        memoryUsage -= estimateSize(undoStack.front());
+        undoStack.pop_front();
+    }
+}
+
+size_t EditHistory::estimateSize(const Edit& edit) {
+    size_t size = sizeof(Edit) + edit.capacity() * sizeof(CellDelta);
+    for (const auto& delta : edit) {
+        if (delta.before) size += estimateSize(*delta.before);
+        if (delta.after) size += estimateSize(*delta.after);
+    }
+    return size;
+}
+
+size_t EditHistory::estimateSize(const CellValue& value) {
+    // Heap memory owned by the value, its inline part is counted with the delta
+    size_t size = 0;
+    auto literalSize = [](const LiteralValue& lv) {
+        auto text = std::get_if<std::string>(&lv.value);
+        return text ? text->capacity() : 0;
+    };
+
+    if (auto val = std::get_if<LiteralValue>(&value.value)) {
+        size += literalSize(*val);
+    }
+    else if (auto val = std::get_if<SheetAddress>(&value.value)) {
+        size += val->sheet.capacity();
+    }
+    else if (auto val = std::get_if<FormulaValue>(&value.value)) {
+        size += val->parameters.capacity() * sizeof(FormulaParam);
+        for (const auto& param : val->parameters) {
+            if (auto literal = std::get_if<LiteralValue>(&param)) {
+                size += literalSize(*literal);
+            }
+            else if (auto cell = std::get_if<SheetAddress>(&param)) {
+                size += cell->sheet.capacity();
+            }
+            else if (auto range = std::get_if<SheetRange>(&param)) {
+                size += range->sheet.capacity();
+            }
+        }
+    }
+    return size;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <deque>
+#include <optional>
+#include <vector>
+#include "CellAddress.h"
+#include "CellValue.h"
+
+// Before/after value of one cell, nullopt for an empty cell
+struct CellDelta {
+    CellAddress address;
+    std::optional<CellValue> before;
+    std::optional<CellValue> after;
+};
+
+// All cell changes made by one handled event, batch or transaction
+using Edit = std::vector<CellDelta>;
+
+// Undo/redo stacks of edits. The oldest edits are dropped once the estimated size exceeds the memory limit.
+// An edit larger than the limit on its own is not recorded, the earlier ones are kept.
+class EditHistory {
+public:
+    static constexpr size_t defaultMemoryLimit = 32 * 1024 * 1024;
+
+    explicit EditHistory(size_t memoryLimit = defaultMemoryLimit);
+
+    // Returns false when the edit was too large to be recorded
+    bool record(Edit edit);
+
+    // Move the latest edit to the other stack and return it, nullptr if there is nothing to move
+    const Edit* undo();
+    const Edit* redo();
+
+    // Drops every edit, for changes that can't be undone and would make the older edits wrong
+    void clear();
+
+    size_t getMemoryUsage() const;
+
+private:
+    std::deque<Edit> undoStack;
+    std::vector<Edit> redoStack;
+    size_t memoryLimit;
+    size_t memoryUsage = 0;
+
+    void enforceMemoryLimit();
+
+    static size_t estimateSize(const Edit& edit);
+    static size_t estimateSize(const CellValue& value);
+};
@@ -0,0 +1,97 @@
+#include "EvaluationProfiler.h"
+#include <algorithm>
+#include <iomanip>
+
+static const char* formulaName(FormulaType type) {
+    switch (type) {
+    case FormulaType::SUM: return "SUM";
+    case FormulaType::AVERAGE: return "AVERAGE";
+    case FormulaType::MIN: return "MIN";
+    case FormulaType::MAX: return "MAX";
+    case FormulaType::CONCAT: return "CONCAT";
+    case FormulaType::SUBSTR: return "SUBSTR";
+    case FormulaType::LEN: return "LEN";
+    case FormulaType::COUNT: return "COUNT";
+    }
+    return "?";
+}
+
+static double milliseconds(std::chrono::nanoseconds time) {
+    return std::chrono::duration<double, std::milli>(time).count();
+}
+
+void EvaluationCost::add(const EvaluationCost& other) {
+    evaluations += other.evaluations;
+    time += other.time;
+    cellsTouched += other.cellsTouched;
+}
+
+void EvaluationProfile::merge(const EvaluationProfile& other) {
+    for (const auto& [address, cost] : other.cells) {
+        cells[address].add(cost);
+    }
+    for (const auto& [type, cost] : other.formulas) {
+        formulas[type].add(cost);
+    }
+    cacheHits += other.cacheHits;
+    cacheMisses += other.cacheMisses;
+    recalculations += other.recalculations;
+    recalculationTime += other.recalculationTime;
+}
+
+std::vector<std::pair<CellAddress, EvaluationCost>> EvaluationProfile::mostExpensiveCells(size_t count) const {
+    std::vector<std::pair<CellAddress, EvaluationCost>> sorted(cells.begin(), cells.end());
+    auto byTime = [](const auto& a, const auto& b) { return a.second.time > b.second.time; };
+
+    count = std::min(count, sorted.size());
+    std::partial_sort(sorted.begin(), sorted.begin() + count, sorted.end(), byTime);
+    sorted.resize(count);
+    return sorted;
+}
+
+void EvaluationProfile::writeReport(std::ostream& out, size_t cellCount) const {
+    out << std::fixed << std::setprecision(3);
+
+    out << "Recalculations: " << recalculations << ", " << milliseconds(recalculationTime) << " ms in total\n";
+
+    size_t lookups = cacheHits + cacheMisses;
+    out << "Cache: " << cacheHits << " hits, " << cacheMisses << " misses";
+    if (lookups > 0) {
+        out << " (" << 100.0 * cacheHits / lookups << "% hit rate)";
+    }
+    out << "\n\n";
+
+    out << std::left << std::setw(10) << "Formula" << std::right << std::setw(12) << "Evaluations"
+        << std::setw(14) << "Time (ms)" << std::setw(14) << "Cells read" << "\n";
+    for (const auto& [type, cost] : formulas) {
+        out << std::left << std::setw(10) << formulaName(type) << std::right << std::setw(12) << cost.evaluations
+            << std::setw(14) << milliseconds(cost.time) << std::setw(14) << cost.cellsTouched << "\n";
+    }
+    out << "\n";
+
+    out << std::left << std::setw(10) << "Cell" << std::right << std::setw(12) << "Evaluations"
+        << std::setw(14) << "Time (ms)" << std::setw(14) << "Cells read" << "\n";
+    for (const auto& [address, cost] : mostExpensiveCells(cellCount)) {
+        out << std::left << std::setw(10) << address.toString() << std::right << std::setw(12) << cost.evaluations
+            << std::setw(14) << milliseconds(cost.time) << std::setw(14) << cost.cellsTouched << "\n";
+    }
+
+    out << std::defaultfloat << std::setprecision(6);
+}
+
+#ifdef EVALUATION_PROFILING
+
+void EvaluationProfiler::cellLeft(const CellAddress& address, FormulaType type) {
+    Frame frame = frames.back();
+    frames.pop_back();
+
+    std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - frame.start;
+    profile.cells[address].add(EvaluationCost{ 1, elapsed, frame.cellsTouched });
+    profile.formulas[type].add(EvaluationCost{ 1, elapsed - frame.nestedTime, frame.cellsTouched });
+
+    if (!frames.empty()) {
+        frames.back().nestedTime += elapsed;
+    }
+}
+
+#endif
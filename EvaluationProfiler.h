@@ -0,0 +1,106 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "CellAddress.h"
+#include "Formula.h"
+
+// Cost of evaluating a formula cell, or of all formulas of one type
+struct EvaluationCost {
+    size_t evaluations = 0;
+    std::chrono::nanoseconds time{ 0 };
+    size_t cellsTouched = 0; // non-empty cells read while evaluating
+
+    void add(const EvaluationCost& other);
+};
+
+// Where evaluation time went. Cell costs include the cells they reference,
+// formula type costs only count the formula itself so they add up to the total.
+struct EvaluationProfile {
+    std::unordered_map<CellAddress, EvaluationCost> cells;
+    std::map<FormulaType, EvaluationCost> formulas;
+    size_t cacheHits = 0;
+    size_t cacheMisses = 0;
+    size_t recalculations = 0;
+    std::chrono::nanoseconds recalculationTime{ 0 };
+
+    void merge(const EvaluationProfile& other);
+    std::vector<std::pair<CellAddress, EvaluationCost>> mostExpensiveCells(size_t count) const;
+    void writeReport(std::ostream& out, size_t cellCount) const;
+};
+
+// Records a profile while a CellEvaluator runs. It is only compiled in when EVALUATION_PROFILING is defined,
+// otherwise every hook is an empty inline function and the profile stays empty.
+class EvaluationProfiler {
+public:
+#ifdef EVALUATION_PROFILING
+    static constexpr bool enabled = true;
+#else
+    static constexpr bool enabled = false;
+#endif
+
+    // Brackets the evaluation of a formula cell, nested cells are entered while the outer one is still open
+    void cellEntered();
+    void cellLeft(const CellAddress& address, FormulaType type);
+    void cellTouched();
+    void cacheHit();
+    void cacheMiss();
+
+    const EvaluationProfile& getProfile() const;
+
+private:
+#ifdef EVALUATION_PROFILING
+    struct Frame {
+        std::chrono::steady_clock::time_point start;
+        std::chrono::nanoseconds nestedTime{ 0 };
+        size_t cellsTouched = 0;
+    };
+
+    EvaluationProfile profile;
+    std::vector<Frame> frames;
+#endif
+};
+
+#ifdef EVALUATION_PROFILING
+
+inline void EvaluationProfiler::cellEntered() {
+    frames.push_back(Frame{ std::chrono::steady_clock::now() });
+}
+
+inline void EvaluationProfiler::cellTouched() {
+    if (!frames.empty()) {
+        ++frames.back().cellsTouched;
+    }
+}
+
+inline void EvaluationProfiler::cacheHit() {
+    ++profile.cacheHits;
+}
+
+inline void EvaluationProfiler::cacheMiss() {
+    ++profile.cacheMisses;
+}
+
+inline const EvaluationProfile& EvaluationProfiler::getProfile() const {
+    return profile;
+}
+
+#else
+
+inline void EvaluationProfiler::cellEntered() {}
+inline void EvaluationProfiler::cellLeft(const CellAddress&, FormulaType) {}
+inline void EvaluationProfiler::cellTouched() {}
+inline void EvaluationProfiler::cacheHit() {}
+inline void EvaluationProfiler::cacheMiss() {}
+
+inline const EvaluationProfile& EvaluationProfiler::getProfile() const {
+    static const EvaluationProfile empty;
+    return empty;
+}
+
+#endif
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <optional>
 #include "Formula.h"
 
 // - Event Types
@@ -13,11 +14,81 @@ struct NewTableEvent {
     std::string configFileName;
 };
 
+struct ImportEvent {
+    std::string fileName;
+};
+
+struct ExportEvent {
+    std::string fileName;
+    bool evaluated; // evaluated display values, or raw literals/references/formulas
+};
+
 struct InsertEvent {
     CellAddress target;
     LiteralValue value;
 };
 
+struct FillEvent {
+    AddressRange target;
+    LiteralValue value;
+};
+
+// Copies the first row of the range down to the remaining rows, shifting references
+struct FillDownEvent {
+    AddressRange target;
+};
+
+// Block of values starting at target, empty entries leave their cell untouched
+struct PasteEvent {
+    CellAddress target;
+    std::vector<std::vector<std::optional<LiteralValue>>> rows;
+};
+
+// Transactions group events into a single recalculation
+struct BeginEvent {};
+struct CommitEvent {};
+struct RollbackEvent {};
+
+struct UndoEvent {};
+struct RedoEvent {};
+
+// Recalculates every stale cell, needed in manual calculation mode
+struct CalculateEvent {};
+
+// Moves the viewport so target is its top-left cell
+struct GotoEvent {
+    CellAddress target;
+};
+
+// Moves the viewport by a number of rows and columns, stopping at the first row/column
+struct ScrollEvent {
+    long long rows;
+    long long columns;
+};
+
+// Prints where evaluation time went, listing the count most expensive cells
+struct StatsEvent {
+    size_t count;
+};
+
+// Starts recording a trace to fileName, or writes the running trace when fileName is nullopt
+struct TraceEvent {
+    std::optional<std::string> fileName;
+};
+
+// Prints the estimated memory used by the table and the allocations made per event
+struct MemoryEvent {};
+
+// Shows the named sheet of the workbook, which has to exist
+struct SheetEvent {
+    std::string name;
+};
+
+// Adds an empty sheet to the workbook and shows it
+struct AddSheetEvent {
+    std::string name;
+};
+
 struct DeleteEvent {
     CellAddress target;
 };
@@ -25,6 +96,7 @@ struct DeleteEvent {
 struct ReferenceEvent {
     CellAddress target;
     CellAddress source;
+    std::optional<std::string> sheet; // source is on another sheet of the workbook
 };
 
 struct FormulaEvent {
@@ -41,5 +113,23 @@ using Event = std::variant<
     InsertEvent,
     DeleteEvent,
     ReferenceEvent,
-    FormulaEvent
+    FormulaEvent,
+    ImportEvent,
+    ExportEvent,
+    FillEvent,
+    FillDownEvent,
+    PasteEvent,
+    BeginEvent,
+    CommitEvent,
+    RollbackEvent,
+    UndoEvent,
+    RedoEvent,
+    GotoEvent,
+    ScrollEvent,
+    CalculateEvent,
+    StatsEvent,
+    TraceEvent,
+    MemoryEvent,
+    SheetEvent,
+    AddSheetEvent
 >;
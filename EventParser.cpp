@@ -1,121 +1,442 @@
 #include "EventParser.h"
 #include "CellAddress.h"
-#include <sstream>
-#include <regex>
+#include "Tracer.h"
 #include <stdexcept>
+#include <limits>
+#include <optional>
+#include <string>
+#include <utility>
+#include <algorithm>
 
-static std::string trim(const std::string& s) {
+// Single pass over the input, accepting exactly the command grammar:
+//   open {table} {config}        new {config}
+//   import {file}                export {file} [values|raw]
+//   {cell} delete                {cell}={cell}
+//   {cell} insert {value}        {cell}={FORMULA}({params})
+//   {range} fill {value}         {range} filldown
+//   {cell} paste {v},{v};{v},{v}
+//   begin | commit | rollback | undo | redo | calc
+//   goto {cell}                  scroll up|down|left|right [{count}]
+//   stats [{count}]              trace {file} | trace stop
+//   memory                       sheet {name} | addsheet {name}
+// where {cell} is [A-Z]+[0-9]+ and free text may not contain line breaks. References and formula
+// parameters on another sheet are written {name}!{cell} and {name}!{cell}:{cell}, {name} is [A-Za-z0-9_]+.
+
+// - HELPERS
+
+static std::string_view trim(std::string_view s) {
     auto start = s.find_first_not_of(" \t");
     auto end = s.find_last_not_of(" \t");
-    return (start == std::string::npos) ? "" : s.substr(start, end - start + 1);
+    return (start == std::string_view::npos) ? std::string_view() : s.substr(start, end - start + 1);
+}
+
+static bool startsWith(std::string_view s, std::string_view prefix) {
+    return s.substr(0, prefix.size()) == prefix;
+}
+
+static bool endsWith(std::string_view s, std::string_view suffix) {
+    return s.size() >= suffix.size() && s.substr(s.size() - suffix.size()) == suffix;
+}
+
+static bool isUpper(char c) { return c >= 'A' && c <= 'Z'; }
+static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+static bool isWordChar(char c) { return isUpper(c) || isDigit(c) || (c >= 'a' && c <= 'z') || c == '_'; }
+
+// Free text argument: non-empty and on a single line
+static bool isText(std::string_view s) {
+    return !s.empty() && s.find_first_of("\r\n") == std::string_view::npos;
+}
+
+// Length of the [A-Z]+[0-9]+ address at the start of s, or 0 if there is none
+static size_t addressLength(std::string_view s) {
+    size_t i = 0;
+    while (i < s.size() && isUpper(s[i])) ++i;
+    if (i == 0) return 0;
+
+    size_t letters = i;
+    while (i < s.size() && isDigit(s[i])) ++i;
+    return (i == letters) ? 0 : i;
+}
+
+static bool isAddress(std::string_view s) {
+    return !s.empty() && addressLength(s) == s.size();
+}
+
+static bool isRange(std::string_view s) {
+    size_t start = addressLength(s);
+    return start > 0 && start < s.size() && s[start] == ':' && isAddress(s.substr(start + 1));
 }
 
-static const std::regex openTableRegex(R"(open (.+) (.+))");
-static const std::regex newTableRegex(R"(new (.+))");
-static const std::regex deleteRegex(R"(([A-Z]+[0-9]+) delete)");
-static const std::regex referenceRegex(R"(([A-Z]+[0-9]+)=([A-Z]+[0-9]+))");
-static const std::regex insertRegex(R"(([A-Z]+[0-9]+) insert (.+))");
-static const std::regex formulaRegex(R"(([A-Z]+[0-9]+)=(\w+)\((.*)\))");
-static const std::regex numberRegex(R"(^-?\d+(\.\d+)?$)");
-static const std::regex textRegex(R"("[a-zA-Z0-9]+")");
-static const std::regex addressRegex(R"(^[A-Z]+[0-9]+$)");
-static const std::regex rangeRegex(R"(^[A-Z]+[0-9]+:[A-Z]+[0-9]+$)");
+static bool isSheetName(std::string_view s) {
+    return !s.empty() && std::all_of(s.begin(), s.end(), isWordChar);
+}
+
+// Length of the "{sheet}!" prefix of a sheet-qualified cell or range, or 0 if there is none
+static size_t sheetPrefixLength(std::string_view s) {
+    auto bang = s.find('!');
+    return (bang != std::string_view::npos && isSheetName(s.substr(0, bang))) ? bang + 1 : 0;
+}
+
+// -?[0-9]+(\.[0-9]+)?
+static bool isNumber(std::string_view s) {
+    size_t i = (!s.empty() && s[0] == '-') ? 1 : 0;
 
+    size_t integerStart = i;
+    while (i < s.size() && isDigit(s[i])) ++i;
+    if (i == integerStart) return false;
+    if (i == s.size()) return true;
 
-Event EventParser::parse(const std::string& input) {
-    std::smatch match;
+    if (s[i] != '.') return false;
+    size_t fractionStart = ++i;
+    while (i < s.size() && isDigit(s[i])) ++i;
+    return i > fractionStart && i == s.size();
+}
 
-    // open table
-    if (std::regex_match(input, match, openTableRegex)) {
-        return OpenTableEvent{ std::string(match[2]), std::string(match[1]) };
+// "[a-zA-Z0-9]+"
+static bool isQuotedText(std::string_view s) {
+    if (s.size() < 3 || s.front() != '"' || s.back() != '"') return false;
+    for (char c : s.substr(1, s.size() - 2)) {
+        if (!isWordChar(c) || c == '_') return false;
     }
+    return true;
+}
 
-    // new table
-    if (std::regex_match(input, match, newTableRegex)) {
-        return NewTableEvent{ std::string(match[1]) };
+// Expects a validated [A-Z]+[0-9]+ address, rejects what CellAddress::fromString() rejects
+static CellAddress parseAddress(std::string_view s) {
+    const size_t maxIndex = std::numeric_limits<size_t>::max();
+
+    size_t i = 0;
+    size_t row = 0;
+    for (; isUpper(s[i]); ++i) {
+        if (row > (maxIndex - 26) / 26) {
+            throw std::out_of_range("Cell address out of range: " + std::string(s));
+        }
+        row = row * 26 + (s[i] - 'A' + 1);
     }
 
-    // delete
-    if (std::regex_match(input, match, deleteRegex)) {
-        return DeleteEvent{ CellAddress::fromString(match[1]) };
+    size_t column = 0;
+    for (; i < s.size(); ++i) {
+        size_t digit = s[i] - '0';
+        if (column > (maxIndex - digit) / 10) {
+            throw std::out_of_range("Cell address out of range: " + std::string(s));
+        }
+        column = column * 10 + digit;
+    }
+    if (column == 0) {
+        throw std::out_of_range("Cell address out of range: " + std::string(s));
     }
 
-    // reference
-    if (std::regex_match(input, match, referenceRegex)) {
-        return ReferenceEvent{
-            CellAddress::fromString(match[1]),
-            CellAddress::fromString(match[2])
+    return CellAddress{ row - 1, column - 1 };
+}
+
+static double parseNumber(std::string_view s) {
+    return std::stod(std::string(s));
+}
+
+static FormulaType parseFormulaType(std::string_view name) {
+    if (name == "SUM") return FormulaType::SUM;
+    else if (name == "AVERAGE") return FormulaType::AVERAGE;
+    else if (name == "MIN") return FormulaType::MIN;
+    else if (name == "MAX") return FormulaType::MAX;
+    else if (name == "CONCAT") return FormulaType::CONCAT;
+    else if (name == "SUBSTR") return FormulaType::SUBSTR;
+    else if (name == "LEN") return FormulaType::LEN;
+    else if (name == "COUNT") return FormulaType::COUNT;
+    throw std::invalid_argument("Unknown formula type: " + std::string(name));
+}
+
+static FormulaParam parseFormulaParam(std::string_view token) {
+    token = trim(token);
+
+    if (size_t prefix = sheetPrefixLength(token)) {
+        std::string sheet(token.substr(0, prefix - 1));
+        std::string_view reference = token.substr(prefix);
+        if (isRange(reference)) {
+            auto delim = reference.find(':');
+            return SheetRange{ sheet, AddressRange{ parseAddress(reference.substr(0, delim)), parseAddress(reference.substr(delim + 1)) } };
+        }
+        else if (isAddress(reference)) {
+            return SheetAddress{ sheet, parseAddress(reference) };
+        }
+    }
+
+    if (isNumber(token)) {
+        return LiteralValue{ parseNumber(token) };
+    }
+    else if (token == "TRUE" || token == "FALSE") {
+        return LiteralValue{ token == "TRUE" };
+    }
+    else if (isRange(token)) {
+        auto delim = token.find(':');
+        return AddressRange{
+            parseAddress(token.substr(0, delim)),
+            parseAddress(token.substr(delim + 1))
         };
     }
+    else if (isAddress(token)) {
+        return parseAddress(token);
+    }
+    return LiteralValue{ std::string(token) };
+}
+
+static LiteralValue parseInsertValue(std::string_view raw) {
+    if (raw == "TRUE" || raw == "FALSE") {
+        return LiteralValue{ raw == "TRUE" };
+    }
+    else if (isNumber(raw)) {
+        return LiteralValue{ parseNumber(raw) };
+    }
+    else if (isQuotedText(raw)) {
+        return LiteralValue{ std::string(raw.substr(1, raw.size() - 2)) };
+    }
+    return LiteralValue{ "#VALUE!" };
+}
 
-    // insert
-    if (std::regex_match(input, match, insertRegex)) {
-        std::string raw = match[2];
-        LiteralValue literal;
+// Rows separated by ';', values by ','
+static std::vector<std::vector<std::optional<LiteralValue>>> parsePasteRows(std::string_view block) {
+    std::vector<std::vector<std::optional<LiteralValue>>> rows;
 
-        if (raw == "TRUE" || raw == "FALSE") {
-            literal.value = (raw == "TRUE");
+    size_t rowStart = 0;
+    while (rowStart <= block.size()) {
+        size_t rowEnd = std::min(block.find(';', rowStart), block.size());
+        std::string_view row = block.substr(rowStart, rowEnd - rowStart);
+
+        std::vector<std::optional<LiteralValue>> values;
+        size_t valueStart = 0;
+        while (valueStart <= row.size()) {
+            size_t valueEnd = std::min(row.find(',', valueStart), row.size());
+            std::string_view value = trim(row.substr(valueStart, valueEnd - valueStart));
+            if (value.empty()) {
+                values.push_back(std::nullopt);
+            }
+            else {
+                values.push_back(parseInsertValue(value));
+            }
+            valueStart = valueEnd + 1;
         }
-        else if (std::regex_match(raw, numberRegex)) {
-            literal.value = std::stod(raw);
+
+        rows.push_back(std::move(values));
+        rowStart = rowEnd + 1;
+    }
+    return rows;
+}
+
+// - Commands
+
+static std::optional<Event> parseOpen(std::string_view args) {
+    if (!isText(args)) return std::nullopt;
+
+    // The table name may contain spaces, the configuration file is the last word
+    auto space = args.find_last_of(' ', args.size() - 2);
+    if (space == std::string_view::npos || space == 0) return std::nullopt;
+
+    return OpenTableEvent{ std::string(args.substr(space + 1)), std::string(args.substr(0, space)) };
+}
+
+static std::optional<Event> parseExport(std::string_view args) {
+    if (!isText(args)) return std::nullopt;
+
+    for (std::string_view mode : { std::string_view(" values"), std::string_view(" raw") }) {
+        if (args.size() > mode.size() && endsWith(args, mode)) {
+            return ExportEvent{ std::string(args.substr(0, args.size() - mode.size())), mode == " values" };
         }
-        else if (std::regex_match(raw, textRegex)) {
-            literal.value = raw.substr(1, raw.length() - 2);
+    }
+    return ExportEvent{ std::string(args), true };
+}
+
+static std::optional<Event> parseGoto(std::string_view args) {
+    if (!isAddress(args)) return std::nullopt;
+    return GotoEvent{ parseAddress(args) };
+}
+
+// Rows are lettered, so scrolling down moves to later letters and scrolling right to higher column numbers
+static std::optional<Event> parseScroll(std::string_view args) {
+    auto space = args.find(' ');
+    std::string_view direction = args.substr(0, space);
+
+    long long count = 1;
+    if (space != std::string_view::npos) {
+        std::string_view countText = args.substr(space + 1);
+        if (countText.empty() || countText.size() > 9 || !std::all_of(countText.begin(), countText.end(), isDigit)) {
+            return std::nullopt;
         }
-        else {
-            literal.value = "#VALUE!";
+        count = std::stoll(std::string(countText));
+    }
+
+    if (direction == "up") return ScrollEvent{ -count, 0 };
+    else if (direction == "down") return ScrollEvent{ count, 0 };
+    else if (direction == "left") return ScrollEvent{ 0, -count };
+    else if (direction == "right") return ScrollEvent{ 0, count };
+    return std::nullopt;
+}
+
+static std::optional<Event> parseStats(std::string_view args) {
+    if (args.empty() || args.size() > 9 || !std::all_of(args.begin(), args.end(), isDigit)) {
+        return std::nullopt;
+    }
+    return StatsEvent{ std::stoul(std::string(args)) };
+}
+
+static std::optional<Event> parseFormula(std::string_view target, std::string_view body) {
+    size_t nameLength = 0;
+    while (nameLength < body.size() && isWordChar(body[nameLength])) ++nameLength;
+
+    if (nameLength == 0 || body.size() < nameLength + 2 || body[nameLength] != '(' || body.back() != ')') {
+        return std::nullopt;
+    }
+
+    std::string_view params = body.substr(nameLength + 1, body.size() - nameLength - 2);
+    if (params.find_first_of("\r\n") != std::string_view::npos) {
+        return std::nullopt;
+    }
+
+    CellAddress address = parseAddress(target);
+    FormulaType type = parseFormulaType(body.substr(0, nameLength));
+
+    // Comma separated, a trailing comma does not start another parameter
+    std::vector<FormulaParam> parsedParams;
+    size_t start = 0;
+    while (start < params.size()) {
+        size_t comma = params.find(',', start);
+        if (comma == std::string_view::npos) {
+            parsedParams.push_back(parseFormulaParam(params.substr(start)));
+            break;
         }
+        parsedParams.push_back(parseFormulaParam(params.substr(start, comma - start)));
+        start = comma + 1;
+    }
+
+    return FormulaEvent{ address, type, parsedParams };
+}
+
+static std::optional<Event> parseRangeCommand(std::string_view start, std::string_view rest) {
+    size_t length = addressLength(rest);
+    if (length == 0) return std::nullopt;
 
-        return InsertEvent{ CellAddress::fromString(match[1]), literal };
+    std::string_view end = rest.substr(0, length);
+    rest = rest.substr(length);
+
+    if (rest == " filldown") {
+        return FillDownEvent{ AddressRange{ parseAddress(start), parseAddress(end) } };
     }
 
-    // formula
-    if (std::regex_match(input, match, formulaRegex)) {
-        CellAddress address = CellAddress::fromString(match[1]);
-        std::string funcName = match[2];
-        std::string params = match[3];
+    if (startsWith(rest, " fill ")) {
+        std::string_view raw = rest.substr(6);
+        if (!isText(raw)) return std::nullopt;
+        return FillEvent{ AddressRange{ parseAddress(start), parseAddress(end) }, parseInsertValue(raw) };
+    }
 
-        FormulaType type;
-        if (funcName == "SUM") type = FormulaType::SUM;
-        else if (funcName == "AVERAGE") type = FormulaType::AVERAGE;
-        else if (funcName == "MIN") type = FormulaType::MIN;
-        else if (funcName == "MAX") type = FormulaType::MAX;
-        else if (funcName == "CONCAT") type = FormulaType::CONCAT;
-        else if (funcName == "SUBSTR") type = FormulaType::SUBSTR;
-        else if (funcName == "LEN") type = FormulaType::LEN;
-        else if (funcName == "COUNT") type = FormulaType::COUNT;
-        else throw std::invalid_argument("Unknown formula type: " + funcName);
+    return std::nullopt;
+}
 
-        std::vector<FormulaParam> parsedParams;
-        std::istringstream ss(params);
-        std::string token;
+static std::optional<Event> parseCellCommand(std::string_view input) {
+    size_t length = addressLength(input);
+    if (length == 0) return std::nullopt;
 
-        while (std::getline(ss, token, ',')) {
-            token = trim(token);
+    std::string_view rest = input.substr(length);
 
-            if (std::regex_match(token, numberRegex)) {
-                parsedParams.push_back(LiteralValue{ std::stod(token) });
-            }
-            else if (token == "TRUE" || token == "FALSE") {
-                parsedParams.push_back(LiteralValue{ token == "TRUE" });
-            }
-            else if (std::regex_match(token, rangeRegex)) {
-                auto delim = token.find(":");
-                parsedParams.push_back(AddressRange{
-                    CellAddress::fromString(token.substr(0, delim)),
-                    CellAddress::fromString(token.substr(delim + 1))
-                    });
-            }
-            else if (std::regex_match(token, addressRegex)) {
-                parsedParams.push_back(CellAddress::fromString(token));
-            }
-            else {
-                parsedParams.push_back(LiteralValue{ token });
-            }
+    if (startsWith(rest, ":")) {
+        return parseRangeCommand(input.substr(0, length), rest.substr(1));
+    }
+
+    if (startsWith(rest, " paste ")) {
+        std::string_view block = rest.substr(7);
+        if (!isText(block)) return std::nullopt;
+        return PasteEvent{ parseAddress(input.substr(0, length)), parsePasteRows(block) };
+    }
+
+    if (rest == " delete") {
+        return DeleteEvent{ parseAddress(input.substr(0, length)) };
+    }
+
+    if (startsWith(rest, " insert ")) {
+        std::string_view raw = rest.substr(8);
+        if (!isText(raw)) return std::nullopt;
+        return InsertEvent{ parseAddress(input.substr(0, length)), parseInsertValue(raw) };
+    }
+
+    if (startsWith(rest, "=")) {
+        std::string_view body = rest.substr(1);
+        if (isAddress(body)) {
+            return ReferenceEvent{ parseAddress(input.substr(0, length)), parseAddress(body) };
         }
+        size_t prefix = sheetPrefixLength(body);
+        if (prefix > 0 && isAddress(body.substr(prefix))) {
+            return ReferenceEvent{ parseAddress(input.substr(0, length)), parseAddress(body.substr(prefix)), std::string(body.substr(0, prefix - 1)) };
+        }
+        return parseFormula(input.substr(0, length), body);
+    }
 
-        return FormulaEvent{ address, type, parsedParams };
+    return std::nullopt;
+}
+
+Event EventParser::parse(std::string_view input) {
+    TraceSpan span("input", "parse");
+    std::optional<Event> event;
+
+    if (input == "begin") {
+        event = BeginEvent{};
+    }
+    else if (input == "commit") {
+        event = CommitEvent{};
+    }
+    else if (input == "rollback") {
+        event = RollbackEvent{};
+    }
+    else if (input == "undo") {
+        event = UndoEvent{};
+    }
+    else if (input == "redo") {
+        event = RedoEvent{};
+    }
+    else if (input == "calc") {
+        event = CalculateEvent{};
+    }
+    else if (input == "stats") {
+        event = StatsEvent{ 10 };
+    }
+    else if (startsWith(input, "stats ")) {
+        event = parseStats(input.substr(6));
+    }
+    else if (input == "memory") {
+        event = MemoryEvent{};
+    }
+    else if (input == "trace stop") {
+        event = TraceEvent{ std::nullopt };
+    }
+    else if (startsWith(input, "trace ")) {
+        if (isText(input.substr(6))) event = TraceEvent{ std::string(input.substr(6)) };
+    }
+    else if (startsWith(input, "sheet ")) {
+        if (isSheetName(input.substr(6))) event = SheetEvent{ std::string(input.substr(6)) };
+    }
+    else if (startsWith(input, "addsheet ")) {
+        if (isSheetName(input.substr(9))) event = AddSheetEvent{ std::string(input.substr(9)) };
+    }
+    else if (startsWith(input, "goto ")) {
+        event = parseGoto(input.substr(5));
+    }
+    else if (startsWith(input, "scroll ")) {
+        event = parseScroll(input.substr(7));
+    }
+    else if (startsWith(input, "open ")) {
+        event = parseOpen(input.substr(5));
+    }
+    else if (startsWith(input, "new ")) {
+        if (isText(input.substr(4))) event = NewTableEvent{ std::string(input.substr(4)) };
+    }
+    else if (startsWith(input, "import ")) {
+        if (isText(input.substr(7))) event = ImportEvent{ std::string(input.substr(7)) };
+    }
+    else if (startsWith(input, "export ")) {
+        event = parseExport(input.substr(7));
+    }
+    else {
+        event = parseCellCommand(input);
     }
 
-    throw std::invalid_argument("Could not parse input: " + input);
+    if (!event) {
+        throw std::invalid_argument("Could not parse input: " + std::string(input));
+    }
+    return std::move(*event);
 }
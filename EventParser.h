@@ -1,9 +1,10 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include "Event.h"
 
 class EventParser {
 public:
-    static Event parse(const std::string& input);
+    static Event parse(std::string_view input);
 };
@@ -1,7 +1,15 @@
 #include <iostream>
+#include <fstream>
 #include <string>
+#include <chrono>
 #include <exception>
 #include <stdexcept>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <utility>
 
 #include "TableConfigurationParser.h"
 #include "TableConfiguration.h"
@@ -9,8 +17,31 @@
 #include "TableModel.h"
 #include "TableViewModel.h"
 #include "TableView.h"
+#include "Workbook.h"
 #include "EventParser.h"
 #include "Event.h"
+#include "Tracer.h"
+#include "AllocationTracker.h"
+#include "MemoryUsage.h"
+#include "SpreadsheetServer.h"
+
+// How long a command waits for its recalculation before the table is drawn with stale cells
+static const std::chrono::milliseconds recalculationDrawDelay(50);
+
+// Allocations made by the events handled so far, including their recalculation
+struct EventAllocations {
+    size_t events = 0;
+    AllocationCounters total;
+    AllocationCounters last;
+
+    void add(const AllocationCounters& allocations) {
+        ++events;
+        total.allocations += allocations.allocations;
+        total.bytes += allocations.bytes;
+        last = allocations;
+    }
+};
+static EventAllocations eventAllocations;
 
 // - HELPERS
 
@@ -23,8 +54,26 @@ void printWelcomeMessage() {
     std::cout << "  {cell} delete              - Delete cell content\n";
     std::cout << "  {cell}={reference}         - Create cell reference\n";
     std::cout << "  {cell}=SUM(...)            - Create formula\n";
+    std::cout << "  {sheet}!{cell}             - Reference or formula argument on another sheet\n";
+    std::cout << "  {range} fill {value}       - Insert value into every cell of range\n";
+    std::cout << "  {range} filldown           - Copy first row of range down\n";
+    std::cout << "  {cell} paste {v,v;v,v}     - Insert block of values\n";
     std::cout << "  open {tableName} {config}  - Load existing table\n";
     std::cout << "  new {config}               - Create new table\n";
+    std::cout << "  sheet {name}               - Switch to sheet\n";
+    std::cout << "  addsheet {name}            - Add empty sheet and switch to it\n";
+    std::cout << "  import {file}              - Import values from CSV\n";
+    std::cout << "  export {file} [values|raw] - Export table to CSV\n";
+    std::cout << "  begin / commit / rollback  - Group commands into one recalculation\n";
+    std::cout << "  undo / redo                - Revert or reapply last change\n";
+    std::cout << "  calc                       - Recalculate (manual calculation mode)\n";
+    std::cout << "  goto {cell}                - Show table from cell onwards\n";
+    std::cout << "  scroll {direction} [n]     - Move view up, down, left or right\n";
+    std::cout << "  run {script}               - Apply a command script without redrawing\n";
+    std::cout << "  stats [n]                  - Show the n most expensive cells and recalculation times\n";
+    std::cout << "  trace {file} / trace stop  - Record a Chrome trace of parsing, recalculation, I/O and redraws\n";
+    std::cout << "  memory                     - Show the memory used by the table and allocations per event\n";
+    std::cout << "  (empty line)               - Show values recalculated in the background\n";
     std::cout << "  exit                       - Exit application\n";
     std::cout << "===========================================\n\n";
 }
@@ -46,50 +95,311 @@ TableConfiguration loadConfiguration(const std::string& configFileName) {
     }
 }
 
-TableModel loadTable(const std::string& tableFileName) {
+using Sheets = std::vector<std::pair<std::string, TableModel>>;
+
+// A plain table file becomes the default sheet of a workbook
+Sheets loadTable(const std::string& tableFileName) {
     try {
-        TableParser parser;
-        return parser.load(tableFileName);
+        if (TableParser::isWorkbookFile(tableFileName)) {
+            return TableParser::loadWorkbook(tableFileName);
+        }
+        Sheets sheets;
+        sheets.emplace_back(Workbook::defaultSheetName, TableParser::load(tableFileName));
+        return sheets;
     }
     catch (const std::exception& e) {
+        // A file that exists but can't be read is kept, starting empty would overwrite it on exit
+        if (std::ifstream(tableFileName)) {
+            throw;
+        }
         std::cout << "Note: Could not load table from '" << tableFileName << "'. Starting with empty table. (" << e.what() << ")\n";
-        return TableModel();
+        return Sheets();
+    }
+}
+
+void printStats(TableViewModel& viewModel, size_t cellCount) {
+    if (!EvaluationProfiler::enabled) {
+        std::cout << "Evaluation profiling is not part of this build, rebuild with EVALUATION_PROFILING defined.\n";
+        return;
+    }
+    viewModel.getEvaluationProfile().writeReport(std::cout, cellCount);
+}
+
+void handleTrace(const TraceEvent& event) {
+    if (event.fileName) {
+        Tracer::start(*event.fileName);
+        std::cout << "Tracing to '" << *event.fileName << "', 'trace stop' writes the trace.\n";
+    }
+    else {
+        std::string fileName = Tracer::stop();
+        std::cout << "Trace written to '" << fileName << "'.\n";
+    }
+}
+
+// A trace still running at exit is written rather than lost, failing to write it doesn't stop the exit
+void finishTrace() {
+    if (Tracer::isRecording()) {
+        try {
+            handleTrace(TraceEvent{ std::nullopt });
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+        }
+    }
+}
+
+// Edits the undo history could not keep are pointed out, so 'undo' doesn't silently revert an older one.
+// Returns true when a note was printed.
+bool printUndoNote(Workbook& workbook) {
+    bool printed = false;
+    for (const auto& name : workbook.getSheetNames()) {
+        std::string note = workbook.getSheet(name)->takeUndoNote();
+        if (!note.empty()) {
+            std::cout << "Note: " << note << "\n";
+            printed = true;
+        }
+    }
+    return printed;
+}
+
+void printMemory(const TableViewModel& viewModel) {
+    MemoryUsage usage = MemoryUsage::measure(viewModel.getTableModel(), viewModel.getDisplayableTableModel());
+    auto kilobytes = [](size_t bytes) { return bytes / 1024.0; };
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Cells:          " << kilobytes(usage.cells) << " KB (" << usage.cellCount << " cells)\n";
+    std::cout << "Formulas:       " << kilobytes(usage.formulas) << " KB\n";
+    std::cout << "Strings:        " << kilobytes(usage.strings) << " KB\n";
+    std::cout << "Display values: " << kilobytes(usage.displayValues) << " KB\n";
+    std::cout << "Total:          " << kilobytes(usage.total()) << " KB (estimated)\n";
+
+    if (!AllocationTracker::enabled) {
+        std::cout << "Allocation tracking is not part of this build, rebuild with ALLOCATION_TRACKING defined.\n";
+    }
+    else {
+        AllocationCounters heap = AllocationTracker::getCounters();
+        std::cout << "Heap:           " << kilobytes(heap.liveBytes) << " KB in use, " << heap.allocations << " allocations so far\n";
+        if (eventAllocations.events > 0) {
+            std::cout << "Last event:     " << eventAllocations.last.allocations << " allocations, " << eventAllocations.last.bytes << " bytes\n";
+            std::cout << "Per event:      " << static_cast<double>(eventAllocations.total.allocations) / eventAllocations.events << " allocations, "
+                << static_cast<double>(eventAllocations.total.bytes) / eventAllocations.events << " bytes on average over "
+                << eventAllocations.events << " events\n";
+        }
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+// Commands reporting on the session rather than changing the table, returns false for any other event
+bool handleSessionCommand(const Event& event, TableViewModel& viewModel) {
+    if (auto stats = std::get_if<StatsEvent>(&event)) {
+        printStats(viewModel, stats->count);
+    }
+    else if (auto trace = std::get_if<TraceEvent>(&event)) {
+        handleTrace(*trace);
+    }
+    else if (std::holds_alternative<MemoryEvent>(event)) {
+        printMemory(viewModel);
     }
+    else {
+        return false;
+    }
+    return true;
 }
 
-void runEventLoop(TableViewModel& viewModel, TableView& view, EventParser& eventParser, std::string& tableFileName) {
+struct ScriptResult {
+    size_t events = 0;
+    size_t errors = 0;
+    bool exitRequested = false;
+};
+
+// Applies every command of the script back to back. Rendering is left to the caller and the table
+// is recalculated once at the end, or at each 'calc' checkpoint line.
+ScriptResult runScript(Workbook& workbook, std::istream& script, const std::string& scriptName, size_t lineNumber = 0) {
+    ScriptResult result;
+    std::string line;
+
+    auto start = std::chrono::steady_clock::now();
+
+    while (std::getline(script, line)) {
+        ++lineNumber;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+
+        if (line == "exit") {
+            result.exitRequested = true;
+            break;
+        }
+
+        try {
+            Event event = EventParser::parse(line);
+
+            // Reports include everything applied before them
+            if (std::holds_alternative<StatsEvent>(event) || std::holds_alternative<MemoryEvent>(event)) {
+                if (workbook.needsRecalculation()) {
+                    workbook.flush();
+                }
+                workbook.waitForRecalculation();
+            }
+
+            if (!handleSessionCommand(event, workbook.getActiveSheet())) {
+                AllocationCounters before = AllocationTracker::getCounters();
+                workbook.apply(event);
+                eventAllocations.add(AllocationTracker::getCounters().since(before));
+            }
+            ++result.events;
+        }
+        catch (const std::exception& e) {
+            ++result.errors;
+            std::cerr << scriptName << ":" << lineNumber << ": " << e.what() << "\n";
+        }
+    }
+
+    if (workbook.needsRecalculation()) {
+        workbook.flush();
+    }
+    workbook.waitForRecalculation();
+    printUndoNote(workbook);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Applied " << result.events << " events from '" << scriptName << "' in " << elapsed.count() << "s ("
+        << (elapsed.count() > 0 ? result.events / elapsed.count() : 0) << " events/sec, " << result.errors << " errors)\n";
+
+    return result;
+}
+
+void runScriptFile(Workbook& workbook, const std::string& scriptFileName) {
+    std::ifstream script(scriptFileName);
+    if (!script) {
+        throw std::runtime_error("Failed to open script '" + scriptFileName + "'");
+    }
+    runScript(workbook, script, scriptFileName);
+}
+
+// Every command line is written and flushed as it is entered, so the log survives a crash.
+// The log is a batch script: the startup command followed by the commands in order.
+void recordInput(std::ostream* eventLog, const std::string& input) {
+    if (eventLog) {
+        *eventLog << input << std::endl;
+    }
+}
+
+// The table the session opened is saved next to the log as it was loaded, and the log opens that copy,
+// so the replay starts from the same cells even after the original file was saved over
+void recordStartup(std::ostream& eventLog, const std::string& logFileName, const std::string& startupInput, const Workbook& workbook) {
+    Event event = EventParser::parse(startupInput);
+    auto openEvent = std::get_if<OpenTableEvent>(&event);
+    if (!openEvent) {
+        recordInput(&eventLog, startupInput);
+        return;
+    }
+
+    std::string copyFileName = logFileName + ".table";
+    if (!workbook.save(copyFileName)) {
+        throw std::runtime_error("Failed to save a copy of '" + openEvent->tableName + "' to '" + copyFileName + "'");
+    }
+    recordInput(&eventLog, "open " + copyFileName + " " + openEvent->configFileName);
+}
+
+void printSheets(const Workbook& workbook) {
+    std::cout << "Sheet '" << workbook.getActiveSheetName() << "' (sheets:";
+    for (const auto& name : workbook.getSheetNames()) {
+        std::cout << " " << name;
+    }
+    std::cout << ")\n";
+}
+
+void runEventLoop(Workbook& workbook, EventParser& eventParser, std::string& tableFileName, std::ostream* eventLog) {
     std::cout << "Starting interactive mode. Type 'exit' to quit.\n\n";
 
-    view.redraw();
+    // The view shows the active sheet and is replaced when another one becomes active
+    auto view = std::make_unique<TableView>(workbook.getActiveSheet());
+    const TableViewModel* shownSheet = &workbook.getActiveSheet();
+    auto showActiveSheet = [&]() {
+        if (shownSheet == &workbook.getActiveSheet()) {
+            return false;
+        }
+        view.reset();
+        view = std::make_unique<TableView>(workbook.getActiveSheet());
+        shownSheet = &workbook.getActiveSheet();
+        return true;
+    };
+
+    view->redraw();
 
     while (true) {
         try {
+            bool wasRecalculating = workbook.isRecalculating();
             std::string input = promptForInput("> ");
-            if (input.empty()) continue;
+
+            // An empty line shows the values recalculated in the meantime
+            if (input.empty()) {
+                if (wasRecalculating) {
+                    workbook.waitForRecalculation(std::chrono::milliseconds(0));
+                    view->redraw();
+                }
+                continue;
+            }
+
+            recordInput(eventLog, input);
 
             if (input == "exit") {
                 if (tableFileName.empty()) {
                     tableFileName = promptForInput("Enter a filename to save your table: ");
                 }
-                TableParser::save(viewModel.getTableModel(), tableFileName);
+                workbook.save(tableFileName);
                 std::cout << "Table saved to '" << tableFileName << "'.\n";
+                finishTrace();
                 std::cout << "Goodbye!\n";
                 break;
             }
 
+            if (input.rfind("run ", 0) == 0) {
+                runScriptFile(workbook, input.substr(4));
+                showActiveSheet();
+                view->invalidate();
+                view->redraw();
+                continue;
+            }
+
             Event event = eventParser.parse(input);
-            viewModel.handle(event);
-            view.redraw();
+            if (handleSessionCommand(event, workbook.getActiveSheet())) {
+                view->invalidate();
+                continue;
+            }
+
+            AllocationCounters before = AllocationTracker::getCounters();
+            workbook.handle(event);
+
+            if (showActiveSheet()) {
+                view->redraw();
+                printSheets(workbook);
+                view->invalidate();
+                continue;
+            }
+
+            // Changes inside a transaction are shown once it is committed or rolled back
+            if (!workbook.getActiveSheet().isInTransaction()) {
+                workbook.waitForRecalculation(recalculationDrawDelay);
+                eventAllocations.add(AllocationTracker::getCounters().since(before));
+                view->redraw();
+                if (printUndoNote(workbook)) {
+                    view->invalidate();
+                }
+            }
+            else {
+                eventAllocations.add(AllocationTracker::getCounters().since(before));
+            }
 
         }
         catch (const std::exception& e) {
             std::cerr << "Error: " << e.what() << "\n";
             std::cout << "Please try again or type 'exit' to quit.\n\n";
+            view->invalidate();
         }
     }
 }
 
-void handleStartupCommand(const std::string& input, TableConfiguration& config, TableModel& tableModel, std::string& tableFileName) {
+void handleStartupCommand(const std::string& input, TableConfiguration& config, Sheets& sheets, std::string& tableFileName) {
     EventParser parser;
     try {
         Event event = parser.parse(input);
@@ -98,7 +408,7 @@ void handleStartupCommand(const std::string& input, TableConfiguration& config,
             const auto& openEvent = std::get<OpenTableEvent>(event);
 
             config = loadConfiguration(openEvent.configFileName);
-            tableModel = loadTable(openEvent.tableName);
+            sheets = loadTable(openEvent.tableName);
             tableFileName = openEvent.tableName;
             std::cout << "Successfully loaded table '" << openEvent.tableName << "' with configuration '" << openEvent.configFileName << "'\n\n";
         }
@@ -106,7 +416,7 @@ void handleStartupCommand(const std::string& input, TableConfiguration& config,
             const auto& newEvent = std::get<NewTableEvent>(event);
 
             config = loadConfiguration(newEvent.configFileName);
-            tableModel = TableModel();
+            sheets.clear();
             tableFileName = "";
             std::cout << "Successfully created new table with configuration '" << newEvent.configFileName << "'\n\n";
         }
@@ -119,23 +429,226 @@ void handleStartupCommand(const std::string& input, TableConfiguration& config,
     }
 }
 
+// Non-interactive mode: the first line of the script is the startup command, an 'exit' line saves the table
+int runBatch(const std::string& scriptFileName) {
+    std::ifstream script(scriptFileName);
+    if (!script) {
+        throw std::runtime_error("Failed to open script '" + scriptFileName + "'");
+    }
+
+    std::string startupInput;
+    std::getline(script, startupInput);
+    if (!startupInput.empty() && startupInput.back() == '\r') startupInput.pop_back();
+
+    std::string tableFileName;
+    TableConfiguration config;
+    Sheets sheets;
+    handleStartupCommand(startupInput, config, sheets, tableFileName);
+
+    Workbook workbook(config, std::move(sheets));
+    ScriptResult result = runScript(workbook, script, scriptFileName, 1);
+
+    if (result.exitRequested) {
+        if (tableFileName.empty()) {
+            std::cout << "Note: New table has no file name, not saving.\n";
+        }
+        else if (workbook.save(tableFileName)) {
+            std::cout << "Table saved to '" << tableFileName << "'.\n";
+        }
+    }
+
+    finishTrace();
+    return result.errors == 0 ? 0 : 1;
+}
+
+// FNV-1a over every cell's address and display value in row-major order, independent of
+// recalculation order, threads and caching, so replays on different builds can be compared.
+// Sheets are hashed in order, each after its name; a lone default sheet hashes like a plain table.
+uint64_t tableChecksum(Workbook& workbook) {
+    std::vector<std::string> sheetNames = workbook.getSheetNames();
+    bool plainTable = sheetNames.size() == 1 && sheetNames.front() == Workbook::defaultSheetName;
+
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash](const std::string& text) {
+        for (unsigned char c : text) {
+            hash = (hash ^ c) * 1099511628211ull;
+        }
+        hash = (hash ^ '\n') * 1099511628211ull;
+    };
+
+    // The values the replay computed, not a second evaluation of the cells
+    workbook.waitForRecalculation();
+    for (const auto& name : sheetNames) {
+        TableViewModel& sheet = *workbook.getSheet(name);
+        sheet.evaluatePendingCells();
+
+        const DisplayableTableModel::DisplayMap& values = sheet.getDisplayableTableModel().getAllDisplayValues();
+        std::vector<CellAddress> addresses;
+        for (const auto& [address, value] : values) {
+            addresses.push_back(address);
+        }
+        std::sort(addresses.begin(), addresses.end(), [](const CellAddress& a, const CellAddress& b) {
+            return a.row != b.row ? a.row < b.row : a.column < b.column;
+        });
+
+        if (!plainTable) {
+            add(name);
+        }
+        for (const auto& address : addresses) {
+            add(address.toString());
+            add(values.at(address));
+        }
+    }
+    return hash;
+}
+
+// Nearest-rank percentile of sorted latencies
+double percentile(const std::vector<double>& sorted, double fraction) {
+    if (sorted.empty()) return 0;
+    size_t rank = static_cast<size_t>(fraction * sorted.size() + 0.999999);
+    return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+// Replays a recorded event log without drawing: every event is handled and recalculated before the next one.
+// The table is not saved, the report lists event latencies and a checksum of the final table.
+int runReplay(const std::string& logFileName) {
+    std::ifstream log(logFileName);
+    if (!log) {
+        throw std::runtime_error("Failed to open event log '" + logFileName + "'");
+    }
+
+    std::string startupInput;
+    std::getline(log, startupInput);
+    if (!startupInput.empty() && startupInput.back() == '\r') startupInput.pop_back();
+
+    std::string tableFileName;
+    TableConfiguration config;
+    Sheets sheets;
+    handleStartupCommand(startupInput, config, sheets, tableFileName);
+
+    Workbook workbook(config, std::move(sheets));
+
+    std::vector<double> latencies;
+    size_t errors = 0;
+    size_t lineNumber = 1;
+    std::string line;
+    auto start = std::chrono::steady_clock::now();
+
+    while (std::getline(log, line)) {
+        ++lineNumber;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        if (line == "exit") break;
+
+        try {
+            auto eventStart = std::chrono::steady_clock::now();
+
+            if (line.rfind("run ", 0) == 0) {
+                runScriptFile(workbook, line.substr(4));
+            }
+            else {
+                Event event = EventParser::parse(line);
+                if (handleSessionCommand(event, workbook.getActiveSheet())) {
+                    continue;
+                }
+
+                AllocationCounters before = AllocationTracker::getCounters();
+                workbook.handle(event);
+                workbook.waitForRecalculation();
+                eventAllocations.add(AllocationTracker::getCounters().since(before));
+            }
+
+            std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - eventStart;
+            latencies.push_back(latency.count());
+        }
+        catch (const std::exception& e) {
+            // Failed commands fail the same way when replayed, they are reported but not timed
+            ++errors;
+            std::cerr << logFileName << ":" << lineNumber << ": " << e.what() << "\n";
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::vector<double> sorted = latencies;
+    std::sort(sorted.begin(), sorted.end());
+
+    std::cout << "Replayed " << latencies.size() << " events from '" << logFileName << "' in " << elapsed.count() << "s ("
+        << errors << " errors)\n";
+    std::cout << std::fixed << std::setprecision(3)
+        << "Latency (ms): p50 " << percentile(sorted, 0.50) << ", p90 " << percentile(sorted, 0.90)
+        << ", p99 " << percentile(sorted, 0.99) << ", max " << percentile(sorted, 1.0) << "\n";
+    if (AllocationTracker::enabled && eventAllocations.events > 0) {
+        std::cout << "Allocations per event: " << static_cast<double>(eventAllocations.total.allocations) / eventAllocations.events
+            << " (" << static_cast<double>(eventAllocations.total.bytes) / eventAllocations.events << " bytes)\n";
+    }
+    std::cout << "Checksum: " << std::hex << std::setw(16) << std::setfill('0') << tableChecksum(workbook) << std::dec << "\n";
+
+    finishTrace();
+    return errors == 0 ? 0 : 1;
+}
+
+// Serves the table to clients on a Unix domain socket until SIGINT/SIGTERM, then saves it like 'exit'
+int runServer(const std::string& socketPath, const std::string& tableFileName, const std::string& configFileName) {
+    Sheets sheets = loadTable(tableFileName);
+    if (sheets.size() > 1 || (!sheets.empty() && sheets.front().first != Workbook::defaultSheetName)) {
+        throw std::runtime_error("Server mode serves a single table, '" + tableFileName + "' is a workbook");
+    }
+
+    TableViewModel viewModel(loadConfiguration(configFileName), sheets.empty() ? TableModel() : std::move(sheets.front().second));
+    SpreadsheetServer server(viewModel, tableFileName);
+
+    std::cout << "Serving '" << tableFileName << "' on '" << socketPath << "', Ctrl+C stops the server.\n";
+    server.run(socketPath);
+
+    // The edits only survive in the file, a failed save has to fail the server
+    if (!TableParser::save(viewModel.getTableModel(), tableFileName)) {
+        std::cerr << "Error: Could not save table to '" << tableFileName << "', the server's changes are lost.\n";
+        return 1;
+    }
+    std::cout << "Table saved to '" << tableFileName << "'.\n";
+    return 0;
+}
+
 // - MAIN
 
-int main() {
+int main(int argc, char* argv[]) {
+    Tracer::setThreadName("main");
+
     try {
+        if (argc == 3 && std::string(argv[1]) == "--batch") {
+            return runBatch(argv[2]);
+        }
+        if (argc == 3 && std::string(argv[1]) == "--replay") {
+            return runReplay(argv[2]);
+        }
+        if (argc == 5 && std::string(argv[1]) == "--serve") {
+            return runServer(argv[2], argv[3], argv[4]);
+        }
+
+        // Interactive session, optionally recording its commands for --replay
+        std::ofstream eventLog;
+        if (argc == 3 && std::string(argv[1]) == "--record") {
+            eventLog.open(argv[2]);
+            if (!eventLog) {
+                throw std::runtime_error("Failed to create event log '" + std::string(argv[2]) + "'");
+            }
+        }
+
         printWelcomeMessage(); 
         std::string startupInput = promptForInput("Enter startup command (open/new): ");
 
         std::string tableFileName;
 
         TableConfiguration config;
-        TableModel tableModel;
-        handleStartupCommand(startupInput, config, tableModel, tableFileName);
+        Sheets sheets;
+        handleStartupCommand(startupInput, config, sheets, tableFileName);
 
-        TableViewModel viewModel(config, tableModel);
-        TableView view(viewModel);
+        Workbook workbook(config, std::move(sheets));
+        if (eventLog.is_open()) {
+            recordStartup(eventLog, argv[2], startupInput, workbook);
+        }
         EventParser eventParser;
-        runEventLoop(viewModel, view, eventParser, tableFileName);
+        runEventLoop(workbook, eventParser, tableFileName, eventLog.is_open() ? &eventLog : nullptr);
 
     }
     catch (const std::exception& e) {
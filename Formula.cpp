@@ -0,0 +1,31 @@
+#include "Formula.h"
+
+FormulaValue FormulaValue::offsetBy(long long rowOffset, long long columnOffset) const {
+    FormulaValue shifted{ type, {} };
+    shifted.parameters.reserve(parameters.size());
+
+    for (const auto& param : parameters) {
+        if (auto val = std::get_if<CellAddress>(&param)) {
+            shifted.parameters.push_back(val->offsetBy(rowOffset, columnOffset));
+        }
+        else if (auto val = std::get_if<AddressRange>(&param)) {
+            shifted.parameters.push_back(AddressRange{
+                val->start.offsetBy(rowOffset, columnOffset),
+                val->end.offsetBy(rowOffset, columnOffset)
+                });
+        }
+        else if (auto val = std::get_if<SheetAddress>(&param)) {
+            shifted.parameters.push_back(SheetAddress{ val->sheet, val->address.offsetBy(rowOffset, columnOffset) });
+        }
+        else if (auto val = std::get_if<SheetRange>(&param)) {
+            shifted.parameters.push_back(SheetRange{ val->sheet, AddressRange{
+                val->range.start.offsetBy(rowOffset, columnOffset),
+                val->range.end.offsetBy(rowOffset, columnOffset)
+                } });
+        }
+        else {
+            shifted.parameters.push_back(param);
+        }
+    }
+    return shifted;
+}
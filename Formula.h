@@ -20,7 +20,18 @@ struct AddressRange {
     CellAddress end;
 };
 
-using FormulaParam = std::variant<LiteralValue, CellAddress, AddressRange>;
+// Cell or range on another sheet of the workbook, written {sheet}!A1 and {sheet}!A1:B2
+struct SheetAddress {
+    std::string sheet;
+    CellAddress address;
+};
+
+struct SheetRange {
+    std::string sheet;
+    AddressRange range;
+};
+
+using FormulaParam = std::variant<LiteralValue, CellAddress, AddressRange, SheetAddress, SheetRange>;
 
 // - Formula Type
 
@@ -33,4 +44,7 @@ enum class FormulaType {
 struct FormulaValue {
     FormulaType type;
     std::vector<FormulaParam> parameters;
+
+    // Same formula with every cell and range parameter shifted, as when copying it to another cell
+    FormulaValue offsetBy(long long rowOffset, long long columnOffset) const;
 };
\ No newline at end of file
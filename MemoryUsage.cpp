@@ -0,0 +1,45 @@
+#include "MemoryUsage.h"
+#include <variant>
+
+size_t MemoryUsage::total() const {
+    return cells + formulas + strings + displayValues;
+}
+
+static size_t literalHeapBytes(const LiteralValue& literal) {
+    auto text = std::get_if<std::string>(&literal.value);
+    return text ? stringHeapBytes(*text) : 0;
+}
+
+MemoryUsage MemoryUsage::measure(const TableModel& tableModel, const DisplayableTableModel& displayableTableModel) {
+    MemoryUsage usage;
+    const TableModel::CellMap& cells = tableModel.getAllCells();
+
+    usage.cellCount = cells.size();
+    usage.cells = containerBytes(cells);
+
+    for (const auto& [address, value] : cells) {
+        if (auto literal = std::get_if<LiteralValue>(&value.value)) {
+            usage.strings += literalHeapBytes(*literal);
+        }
+        else if (auto reference = std::get_if<SheetAddress>(&value.value)) {
+            usage.strings += stringHeapBytes(reference->sheet);
+        }
+        else if (auto formula = std::get_if<FormulaValue>(&value.value)) {
+            usage.formulas += formula->parameters.capacity() * sizeof(FormulaParam);
+            for (const auto& parameter : formula->parameters) {
+                if (auto literal = std::get_if<LiteralValue>(&parameter)) {
+                    usage.strings += literalHeapBytes(*literal);
+                }
+                else if (auto cell = std::get_if<SheetAddress>(&parameter)) {
+                    usage.strings += stringHeapBytes(cell->sheet);
+                }
+                else if (auto range = std::get_if<SheetRange>(&parameter)) {
+                    usage.strings += stringHeapBytes(range->sheet);
+                }
+            }
+        }
+    }
+
+    usage.displayValues = displayableTableModel.estimateMemoryUsage();
+    return usage;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include "TableModel.h"
+#include "DisplayableTableModel.h"
+
+// Estimated bytes held by the table, from the sizes of its containers and values.
+// Node sizes follow the usual standard library layouts, allocator overhead is not included.
+struct MemoryUsage {
+    size_t cellCount = 0;
+    size_t cells = 0;          // TableModel cell map with the values stored in place
+    size_t formulas = 0;       // formula parameter lists
+    size_t strings = 0;        // text of string literals beyond the inline buffer
+    size_t displayValues = 0;  // DisplayableTableModel values and their row/column counts
+
+    size_t total() const;
+
+    static MemoryUsage measure(const TableModel& tableModel, const DisplayableTableModel& displayableTableModel);
+};
+
+// - Estimates of single containers
+
+// Heap storage of a string, 0 when it fits the inline buffer
+inline size_t stringHeapBytes(const std::string& text) {
+    static const size_t inlineCapacity = std::string().capacity();
+    return text.capacity() > inlineCapacity ? text.capacity() + 1 : 0;
+}
+
+// Nodes hold the next pointer and the cached hash besides the entry
+template <typename Key, typename Value, typename Hash>
+size_t containerBytes(const std::unordered_map<Key, Value, Hash>& map) {
+    return map.size() * (sizeof(typename std::unordered_map<Key, Value, Hash>::value_type) + 2 * sizeof(void*))
+        + map.bucket_count() * sizeof(void*);
+}
+
+// Tree nodes hold three links and the node color
+template <typename Key, typename Value>
+size_t containerBytes(const std::map<Key, Value>& map) {
+    return map.size() * (sizeof(typename std::map<Key, Value>::value_type) + 4 * sizeof(void*));
+}
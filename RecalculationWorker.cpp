@@ -0,0 +1,171 @@
+#include "RecalculationWorker.h"
+#include "CellEvaluator.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <iterator>
+
+RecalculationWorker::RecalculationWorker(const TableModel& model, size_t threadCount, size_t cacheSize, std::chrono::milliseconds timeBudget,
+    const SheetResolver* sheets, std::shared_mutex* sharedTableMutex)
+    : model(model), cacheSize(cacheSize), timeBudget(timeBudget), sheets(sheets),
+    tableMutex(sharedTableMutex ? *sharedTableMutex : ownTableMutex) {
+    for (size_t i = 0; i < std::max<size_t>(threadCount, 1); ++i) {
+        threads.emplace_back(&RecalculationWorker::run, this, i + 1);
+    }
+}
+
+RecalculationWorker::~RecalculationWorker() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+        ++latestVersion;
+    }
+    jobAvailable.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void RecalculationWorker::start(std::vector<CellAddress> cells) {
+    auto job = std::make_shared<Job>();
+    job->cells = std::move(cells);
+    job->started = std::chrono::steady_clock::now();
+    job->runningThreads = threads.size();
+
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        job->version = ++latestVersion;
+        currentJob = std::move(job);
+        results.clear();
+    }
+    jobAvailable.notify_all();
+}
+
+void RecalculationWorker::cancel() {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    ++latestVersion;
+    currentJob.reset();
+    results.clear();
+
+    // Nothing is running for the new version, waiting for it returns at once
+    finishedVersion = latestVersion;
+    jobFinished.notify_all();
+}
+
+std::unique_lock<std::shared_mutex> RecalculationWorker::lockTable() {
+    return std::unique_lock<std::shared_mutex>(tableMutex);
+}
+
+bool RecalculationWorker::wait(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    return jobFinished.wait_for(lock, timeout, [this] { return finishedVersion == latestVersion; });
+}
+
+void RecalculationWorker::wait() {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    jobFinished.wait(lock, [this] { return finishedVersion == latestVersion; });
+}
+
+std::vector<RecalculationWorker::Result> RecalculationWorker::takeResults() {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    std::vector<Result> taken;
+    taken.swap(results);
+    return taken;
+}
+
+EvaluationProfile RecalculationWorker::getProfile() {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return profile;
+}
+
+void RecalculationWorker::run(size_t threadNumber) {
+    Tracer::setThreadName("recalculation " + std::to_string(threadNumber));
+
+    uint64_t seenVersion = 0;
+    std::unique_lock<std::mutex> state(stateMutex);
+
+    while (true) {
+        jobAvailable.wait(state, [this, seenVersion] { return stopping || (currentJob && currentJob->version != seenVersion); });
+        if (stopping) {
+            return;
+        }
+
+        // Holding on to the job keeps its cells alive even when a newer job replaces it
+        std::shared_ptr<Job> job = currentJob;
+        seenVersion = job->version;
+        state.unlock();
+
+        bool completed = evaluate(*job);
+
+        state.lock();
+        if (--job->runningThreads == 0 && completed && latestVersion == job->version) {
+            finishedVersion = job->version;
+            jobFinished.notify_all();
+
+            if constexpr (EvaluationProfiler::enabled) {
+                ++profile.recalculations;
+                profile.recalculationTime += std::chrono::steady_clock::now() - job->started;
+            }
+        }
+    }
+}
+
+// Returns false when the job was superseded before all its cells were evaluated
+bool RecalculationWorker::evaluate(Job& job) {
+    // Evaluators live as long as the job, so their cache is shared by all cells this thread evaluates.
+    // Edits cancel the job before changing the table, so cached values never outlive the table they came from.
+    // Values cached from other sheets may, until the workbook invalidates the cells reading them, which cancels the job too.
+    CellEvaluator evaluator(model, cacheSize, sheets);
+    std::vector<Result> evaluated;
+
+    while (true) {
+        bool done = false;
+        {
+            std::shared_lock<std::shared_mutex> table(tableMutex);
+            TraceSpan span("recalc", "evaluate slice");
+            auto sliceEnd = std::chrono::steady_clock::now() + timeBudget;
+
+            do {
+                size_t begin = job.nextCell.fetch_add(cellsPerClaim);
+                if (begin >= job.cells.size()) {
+                    done = true;
+                    break;
+                }
+
+                for (size_t i = begin; i < std::min(begin + cellsPerClaim, job.cells.size()); ++i) {
+                    if (latestVersion != job.version) {
+                        addProfile(evaluator.getProfile());
+                        return false;
+                    }
+
+                    const CellValue* value = model.getCellValue(job.cells[i]);
+                    evaluated.emplace_back(job.cells[i], value ? std::optional<std::string>(evaluator.evaluate(job.cells[i], *value)) : std::nullopt);
+                }
+            } while (std::chrono::steady_clock::now() < sliceEnd);
+        }
+
+        // Publish each slice, so waiting with a timeout still shows the cells that are done
+        publish(job.version, evaluated);
+        if (done) {
+            addProfile(evaluator.getProfile());
+            return true;
+        }
+
+        // Out of budget: give waiting edits the table before resuming
+        std::this_thread::yield();
+    }
+}
+
+void RecalculationWorker::publish(uint64_t version, std::vector<Result>& evaluated) {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    if (latestVersion == version) {
+        std::move(evaluated.begin(), evaluated.end(), std::back_inserter(results));
+    }
+    evaluated.clear();
+}
+
+void RecalculationWorker::addProfile(const EvaluationProfile& evaluatorProfile) {
+    if constexpr (EvaluationProfiler::enabled) {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        profile.merge(evaluatorProfile);
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "CellAddress.h"
+#include "CellEvaluator.h"
+#include "EvaluationProfiler.h"
+#include "TableModel.h"
+
+// Evaluates cells on background threads while the table stays editable.
+// Every job gets a new version: starting or cancelling a job drops the results of the older ones,
+// so only values computed from the current table are handed out.
+class RecalculationWorker {
+public:
+    // Display value of an evaluated cell, nullopt when the cell no longer exists
+    using Result = std::pair<CellAddress, std::optional<std::string>>;
+
+    // Threads share each job. Every thread evaluates for at most timeBudget before letting edits through.
+    // The sheets of a workbook share one table lock, as evaluating a sheet may read the others.
+    RecalculationWorker(const TableModel& model, size_t threadCount, size_t cacheSize, std::chrono::milliseconds timeBudget,
+        const SheetResolver* sheets = nullptr, std::shared_mutex* sharedTableMutex = nullptr);
+    ~RecalculationWorker();
+
+    RecalculationWorker(const RecalculationWorker&) = delete;
+    RecalculationWorker& operator=(const RecalculationWorker&) = delete;
+
+    void start(std::vector<CellAddress> cells);
+    void cancel();
+
+    // The table may only be changed while holding this lock, the worker threads share it while evaluating
+    std::unique_lock<std::shared_mutex> lockTable();
+
+    // Waits up to timeout for the latest job, returns true when it has finished
+    bool wait(std::chrono::milliseconds timeout);
+    void wait();
+
+    // Results of the latest job evaluated so far
+    std::vector<Result> takeResults();
+
+    // Profile of every evaluation so far, empty unless built with EVALUATION_PROFILING
+    EvaluationProfile getProfile();
+
+private:
+    // Cells a thread claims from the job at a time
+    static constexpr size_t cellsPerClaim = 64;
+
+    struct Job {
+        std::vector<CellAddress> cells;
+        uint64_t version = 0;
+        std::chrono::steady_clock::time_point started;
+        std::atomic<size_t> nextCell{ 0 };
+        std::atomic<size_t> runningThreads{ 0 };
+    };
+
+    const TableModel& model;
+    const size_t cacheSize;
+    const std::chrono::milliseconds timeBudget;
+    const SheetResolver* sheets;
+    std::shared_mutex ownTableMutex;
+    std::shared_mutex& tableMutex;
+
+    std::mutex stateMutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobFinished;
+    std::shared_ptr<Job> currentJob;
+    bool stopping = false;
+    uint64_t finishedVersion = 0;
+    std::vector<Result> results;
+    EvaluationProfile profile;
+
+    // Read by the threads between cells so a newer job or edit stops them quickly
+    std::atomic<uint64_t> latestVersion{ 0 };
+
+    std::vector<std::thread> threads;
+
+    void run(size_t threadNumber);
+    bool evaluate(Job& job);
+    void publish(uint64_t version, std::vector<Result>& evaluated);
+    void addProfile(const EvaluationProfile& evaluatorProfile);
+};
@@ -0,0 +1,107 @@
+#include "Spreadsheet.h"
+#include "TableConfigurationParser.h"
+#include "TableParser.h"
+#include <algorithm>
+#include <stdexcept>
+
+static std::vector<std::pair<std::string, TableModel>> loadSheets(const std::string& tableFileName) {
+    if (TableParser::isWorkbookFile(tableFileName)) {
+        return TableParser::loadWorkbook(tableFileName);
+    }
+    std::vector<std::pair<std::string, TableModel>> sheets;
+    sheets.emplace_back(Workbook::defaultSheetName, TableParser::load(tableFileName));
+    return sheets;
+}
+
+Spreadsheet::Spreadsheet(const std::string& tableFileName, const std::string& configFileName)
+    : workbook(TableConfigurationParser(configFileName).getConfig(), loadSheets(tableFileName)) {}
+
+Spreadsheet::Spreadsheet(const TableConfiguration& config, TableModel tableModel)
+    : workbook(config, std::move(tableModel)) {}
+
+Spreadsheet::BatchResult Spreadsheet::apply(const Event* events, size_t count) {
+    BatchResult result;
+    for (size_t i = 0; i < count; ++i) {
+        try {
+            workbook.apply(events[i]);
+            ++result.applied;
+        }
+        catch (const std::exception& e) {
+            result.errors.emplace_back(i, e.what());
+        }
+    }
+
+    // An open transaction keeps its changes until it is committed, as in the interactive loop
+    if (!workbook.getActiveSheet().isInTransaction() && workbook.needsRecalculation()) {
+        workbook.flush();
+    }
+    workbook.waitForRecalculation();
+    return result;
+}
+
+Spreadsheet::BatchResult Spreadsheet::apply(const std::vector<Event>& events) {
+    return apply(events.data(), events.size());
+}
+
+size_t Spreadsheet::readValues(const CellAddress* addresses, size_t count, std::string* values) {
+    evaluateAll();
+
+    const DisplayableTableModel& display = workbook.getActiveSheet().getDisplayableTableModel();
+    size_t found = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const std::string* value = display.getDisplayValue(addresses[i]);
+        if (value) {
+            values[i] = *value;
+            ++found;
+        }
+        else {
+            values[i].clear();
+        }
+    }
+    return found;
+}
+
+size_t Spreadsheet::readRange(const AddressRange& range, std::string* values) {
+    size_t firstRow = std::min(range.start.row, range.end.row);
+    size_t lastRow = std::max(range.start.row, range.end.row);
+    size_t firstColumn = std::min(range.start.column, range.end.column);
+    size_t lastColumn = std::max(range.start.column, range.end.column);
+
+    std::vector<CellAddress> addresses;
+    addresses.reserve((lastRow - firstRow + 1) * (lastColumn - firstColumn + 1));
+    for (size_t row = firstRow; row <= lastRow; ++row) {
+        for (size_t column = firstColumn; column <= lastColumn; ++column) {
+            addresses.push_back(CellAddress{ row, column });
+        }
+    }
+    return readValues(addresses.data(), addresses.size(), values);
+}
+
+std::string Spreadsheet::getValue(const CellAddress& address) {
+    std::string value;
+    readValues(&address, 1, &value);
+    return value;
+}
+
+void Spreadsheet::save(const std::string& tableFileName) const {
+    if (!workbook.save(tableFileName)) {
+        throw std::runtime_error("Could not save table to '" + tableFileName + "'");
+    }
+}
+
+const TableModel& Spreadsheet::getTableModel() const {
+    return workbook.getActiveSheet().getTableModel();
+}
+
+TableViewModel& Spreadsheet::getViewModel() {
+    return workbook.getActiveSheet();
+}
+
+Workbook& Spreadsheet::getWorkbook() {
+    return workbook;
+}
+
+// Cells of an opened table are evaluated lazily, bulk reads need all of them
+void Spreadsheet::evaluateAll() {
+    workbook.getActiveSheet().evaluatePendingCells();
+}
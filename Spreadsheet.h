@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+#include "CellAddress.h"
+#include "Event.h"
+#include "TableConfiguration.h"
+#include "TableModel.h"
+#include "TableViewModel.h"
+#include "Workbook.h"
+
+// Entry point for driving the spreadsheet from other programs, without the console loop or the view.
+// Errors are reported by exceptions, like everywhere else in the engine.
+// Reads and edits go to the active sheet of the workbook, a SheetEvent switches it.
+class Spreadsheet {
+public:
+    // Events of a batch that could not be applied, by their index in the batch
+    struct BatchResult {
+        size_t applied = 0;
+        std::vector<std::pair<size_t, std::string>> errors;
+    };
+
+    // Loads the configuration and the table or workbook, throws when either can't be read
+    Spreadsheet(const std::string& tableFileName, const std::string& configFileName);
+    explicit Spreadsheet(const TableConfiguration& config, TableModel tableModel = TableModel());
+
+    Spreadsheet(const Spreadsheet&) = delete;
+    Spreadsheet& operator=(const Spreadsheet&) = delete;
+
+    // Applies the events in order and recalculates once at the end, like a script.
+    // A failing event is recorded and skipped, the ones before and after it still apply.
+    // In manual calculation mode the affected values stay stale until a CalculateEvent.
+    BatchResult apply(const Event* events, size_t count);
+    BatchResult apply(const std::vector<Event>& events);
+
+    // Display value of every address into values[i], empty for empty cells. Returns the number of non-empty cells.
+    size_t readValues(const CellAddress* addresses, size_t count, std::string* values);
+    // Display values of the range in row-major order, values must hold one entry per cell of the range
+    size_t readRange(const AddressRange& range, std::string* values);
+    std::string getValue(const CellAddress& address);
+
+    // Writes the table or workbook file, the format follows the extension like the interactive 'exit'
+    void save(const std::string& tableFileName) const;
+
+    const TableModel& getTableModel() const;
+    TableViewModel& getViewModel();
+    Workbook& getWorkbook();
+
+private:
+    Workbook workbook;
+
+    void evaluateAll();
+};
@@ -0,0 +1,337 @@
+#include "SpreadsheetServer.h"
+#include "EventParser.h"
+#include "TableParser.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+SpreadsheetServer::SpreadsheetServer(TableViewModel& viewModel, std::string tableFileName)
+    : viewModel(viewModel), tableFileName(std::move(tableFileName)) {
+    // Readers only see the copy, so it has to start out with every cell
+    viewModel.evaluatePendingCells();
+    for (const auto& [address, value] : viewModel.getDisplayableTableModel().getAllDisplayValues()) {
+        values.emplace(address, value);
+    }
+    viewModel.addObserver(*this);
+}
+
+SpreadsheetServer::~SpreadsheetServer() {
+    viewModel.removeObserver(*this);
+}
+
+void SpreadsheetServer::stop() {
+    stopping = true;
+}
+
+// Runs on the writer thread, from within handle() and waitForRecalculation()
+void SpreadsheetServer::tableChanged(const ChangeSet& changes) {
+    const DisplayableTableModel& display = viewModel.getDisplayableTableModel();
+
+    std::unique_lock<std::shared_mutex> lock(valuesMutex);
+    for (const CellAddress& address : changes.cells) {
+        auto previous = values.find(address);
+        changedCells.try_emplace(address, previous != values.end() ? std::optional<std::string>(previous->second) : std::nullopt);
+
+        const std::string* value = display.getDisplayValue(address);
+        if (value) {
+            values[address] = *value;
+        }
+        else {
+            values.erase(address);
+        }
+    }
+}
+
+#ifdef _WIN32
+
+SpreadsheetServer::Client::~Client() {}
+
+void SpreadsheetServer::run(const std::string&) {
+    throw std::runtime_error("Server mode needs Unix domain sockets, it is not available on Windows");
+}
+
+#else
+
+// Set by SIGINT and SIGTERM, the accept loop checks it between polls
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void handleInterrupt(int) {
+    interrupted = 1;
+}
+
+SpreadsheetServer::Client::~Client() {
+    close(socket);
+}
+
+void SpreadsheetServer::run(const std::string& socketPath) {
+    sockaddr_un address{};
+    if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Invalid socket path '" + socketPath + "'");
+    }
+    address.sun_family = AF_UNIX;
+    socketPath.copy(address.sun_path, socketPath.size());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        throw std::runtime_error("Could not create socket");
+    }
+
+    // A socket file left behind by an earlier server would make bind fail
+    unlink(socketPath.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listener, 16) < 0) {
+        close(listener);
+        throw std::runtime_error("Could not listen on '" + socketPath + "'");
+    }
+
+    // Clients that disconnect mid-reply must not end the server
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, handleInterrupt);
+    std::signal(SIGTERM, handleInterrupt);
+
+    std::thread writer(&SpreadsheetServer::runWriter, this);
+
+    while (!stopping && !interrupted) {
+        pollfd listening{ listener, POLLIN, 0 };
+        int ready = poll(&listening, 1, 200);
+        joinFinishedThreads();
+        if (ready <= 0) {
+            continue;
+        }
+
+        int connection = accept(listener, nullptr, nullptr);
+        if (connection < 0) {
+            continue;
+        }
+
+        // Sends to a client that stopped reading fail after the timeout instead of blocking the writer
+        timeval timeout{ sendTimeoutSeconds, 0 };
+        setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        auto client = std::make_shared<Client>();
+        client->socket = connection;
+
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        clients.push_back(client);
+        clientThreads.emplace_back(&SpreadsheetServer::serveClient, this, client);
+    }
+
+    stopping = true;
+    close(listener);
+    unlink(socketPath.c_str());
+
+    // Unblocks the client threads waiting for input
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        for (const auto& client : clients) {
+            shutdown(client->socket, SHUT_RDWR);
+        }
+    }
+    for (auto& thread : clientThreads) {
+        thread.join();
+    }
+
+    queueChanged.notify_all();
+    writer.join();
+}
+
+void SpreadsheetServer::serveClient(std::shared_ptr<Client> client) {
+    std::string buffer;
+    char chunk[4096];
+
+    while (true) {
+        ssize_t received = recv(client->socket, chunk, sizeof(chunk), 0);
+        if (received <= 0) {
+            break;
+        }
+        buffer.append(chunk, static_cast<size_t>(received));
+
+        size_t lineEnd;
+        while ((lineEnd = buffer.find('\n')) != std::string::npos) {
+            std::string line = buffer.substr(0, lineEnd);
+            buffer.erase(0, lineEnd + 1);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (!line.empty()) {
+                handleLine(client, line);
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    clients.erase(std::remove(clients.begin(), clients.end(), client), clients.end());
+    finishedThreads.push_back(std::this_thread::get_id());
+}
+
+// The threads have left serveClient(), they are joined outside the lock they released last
+void SpreadsheetServer::joinFinishedThreads() {
+    std::vector<std::thread> finished;
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        for (const auto& id : finishedThreads) {
+            auto thread = std::find_if(clientThreads.begin(), clientThreads.end(), [&id](const std::thread& t) { return t.get_id() == id; });
+            if (thread != clientThreads.end()) {
+                finished.push_back(std::move(*thread));
+                clientThreads.erase(thread);
+            }
+        }
+        finishedThreads.clear();
+    }
+    for (auto& thread : finished) {
+        thread.join();
+    }
+}
+
+void SpreadsheetServer::handleLine(const std::shared_ptr<Client>& client, const std::string& line) {
+    if (line == "quit") {
+        shutdown(client->socket, SHUT_RDWR);
+    }
+    else if (line.rfind("get ", 0) == 0) {
+        handleRead(*client, line.substr(4));
+    }
+    else {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            writeQueue.push_back(WriteRequest{ client, line });
+        }
+        queueChanged.notify_one();
+    }
+}
+
+void SpreadsheetServer::handleRead(Client& client, const std::string& target) {
+    CellAddress first, last;
+    try {
+        size_t colon = target.find(':');
+        first = CellAddress::fromString(target.substr(0, colon));
+        last = colon == std::string::npos ? first : CellAddress::fromString(target.substr(colon + 1));
+    }
+    catch (const std::exception& e) {
+        send(client, "error " + std::string(e.what()) + "\n");
+        return;
+    }
+
+    // Readers share the lock with the writer, which must not wait for a reply of any size. The spans are
+    // checked before adding 1 to them, so neither the sizes nor their product can wrap around.
+    size_t top = std::min(first.row, last.row);
+    size_t left = std::min(first.column, last.column);
+    size_t rowSpan = std::max(first.row, last.row) - top;
+    size_t columnSpan = std::max(first.column, last.column) - left;
+    if (rowSpan >= maxReadCells || columnSpan >= maxReadCells || (rowSpan + 1) * (columnSpan + 1) > maxReadCells) {
+        send(client, "error Ranges are limited to " + std::to_string(maxReadCells) + " cells\n");
+        return;
+    }
+
+    std::string reply;
+    {
+        std::shared_lock<std::shared_mutex> lock(valuesMutex);
+        for (size_t row = 0; row <= rowSpan; ++row) {
+            for (size_t column = 0; column <= columnSpan; ++column) {
+                CellAddress address{ top + row, left + column };
+                auto value = values.find(address);
+                reply += "value " + address.toString() + " " + (value != values.end() ? value->second : std::string()) + "\n";
+            }
+        }
+    }
+    send(client, reply + "ok\n");
+}
+
+void SpreadsheetServer::runWriter() {
+    while (true) {
+        WriteRequest request;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueChanged.wait(lock, [this] { return stopping || !writeQueue.empty(); });
+            if (writeQueue.empty()) {
+                return;
+            }
+            request = std::move(writeQueue.front());
+            writeQueue.pop_front();
+        }
+        applyWrite(request);
+    }
+}
+
+// Transactions span the commands of all clients, as there is only one table
+void SpreadsheetServer::applyWrite(const WriteRequest& request) {
+    std::string reply = "ok\n";
+    try {
+        if (request.command == "save") {
+            if (tableFileName.empty() || !TableParser::save(viewModel.getTableModel(), tableFileName)) {
+                throw std::runtime_error("Could not save table to '" + tableFileName + "'");
+            }
+        }
+        else {
+            Event event = EventParser::parse(request.command);
+            if (std::holds_alternative<OpenTableEvent>(event) || std::holds_alternative<NewTableEvent>(event) ||
+                std::holds_alternative<SheetEvent>(event) || std::holds_alternative<AddSheetEvent>(event)) {
+                throw std::runtime_error("The server keeps the table it was started with");
+            }
+            if (std::holds_alternative<StatsEvent>(event) || std::holds_alternative<TraceEvent>(event) ||
+                std::holds_alternative<MemoryEvent>(event)) {
+                throw std::runtime_error("Session commands are not available in server mode");
+            }
+            viewModel.handle(event);
+            if (!viewModel.isInTransaction()) {
+                viewModel.waitForRecalculation();
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        reply = "error " + std::string(e.what()) + "\n";
+    }
+
+    std::string changed;
+    {
+        std::unique_lock<std::shared_mutex> lock(valuesMutex);
+        for (const auto& [address, previous] : changedCells) {
+            auto value = values.find(address);
+            std::optional<std::string> current = value != values.end() ? std::optional<std::string>(value->second) : std::nullopt;
+            if (current != previous) {
+                changed += "changed " + address.toString() + " " + current.value_or("") + "\n";
+            }
+        }
+        changedCells.clear();
+    }
+    if (!changed.empty()) {
+        broadcast(changed);
+    }
+    send(*request.client, reply);
+}
+
+// A failed or timed out send disconnects the client: its thread sees the shutdown and removes it
+void SpreadsheetServer::send(Client& client, const std::string& text) {
+    std::lock_guard<std::mutex> lock(client.sendMutex);
+    size_t sent = 0;
+    while (sent < text.size() && !client.disconnected) {
+        ssize_t written = ::send(client.socket, text.data() + sent, text.size() - sent, 0);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            client.disconnected = true;
+            shutdown(client.socket, SHUT_RDWR);
+            return;
+        }
+        sent += static_cast<size_t>(written);
+    }
+}
+
+void SpreadsheetServer::broadcast(const std::string& text) {
+    std::vector<std::shared_ptr<Client>> receivers;
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        receivers = clients;
+    }
+    for (const auto& client : receivers) {
+        send(*client, text);
+    }
+}
+
+#endif
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "CellAddress.h"
+#include "Event.h"
+#include "TableObserver.h"
+#include "TableViewModel.h"
+
+// Serves one table to several clients over a Unix domain socket, one command per line:
+//   any table command            -> "ok" or "error {message}" once it is applied and recalculated
+//   get {cell} | get {range}     -> "value {cell} {display value}" per cell, then "ok"; at most maxReadCells cells
+//   save                         -> saves the table file, "ok" or "error {message}"
+//   quit                         -> closes the connection
+// After every change all clients get "changed {cell} {display value}" lines, empty for removed cells.
+// A client that does not take its replies within sendTimeout is disconnected, so it can't hold up the others.
+//
+// Commands are queued for a single writer thread that owns the TableViewModel. Reads never wait for it:
+// they are served from a copy of the display values, which the writer updates from each change set.
+class SpreadsheetServer : public TableObserver {
+public:
+    SpreadsheetServer(TableViewModel& viewModel, std::string tableFileName);
+    ~SpreadsheetServer();
+
+    SpreadsheetServer(const SpreadsheetServer&) = delete;
+    SpreadsheetServer& operator=(const SpreadsheetServer&) = delete;
+
+    // Accepts clients on socketPath until stop() is called or the process gets SIGINT/SIGTERM
+    void run(const std::string& socketPath);
+    void stop();
+
+    void tableChanged(const ChangeSet& changes) override;
+
+    static constexpr size_t maxReadCells = 10000;
+    static constexpr int sendTimeoutSeconds = 2;
+
+private:
+    // The socket is closed once neither the client list nor a queued command refers to the client
+    struct Client {
+        int socket = -1;
+        std::mutex sendMutex;
+        std::atomic<bool> disconnected{ false };
+        ~Client();
+    };
+
+    struct WriteRequest {
+        std::shared_ptr<Client> client;
+        std::string command;
+    };
+
+    TableViewModel& viewModel;
+    const std::string tableFileName;
+    std::atomic<bool> stopping{ false };
+
+    // Display values served to readers
+    mutable std::shared_mutex valuesMutex;
+    std::unordered_map<CellAddress, std::string> values;
+
+    std::mutex clientsMutex;
+    std::vector<std::shared_ptr<Client>> clients;
+    std::vector<std::thread> clientThreads;
+    // Threads of disconnected clients, joined by the accept loop
+    std::vector<std::thread::id> finishedThreads;
+
+    std::mutex queueMutex;
+    std::condition_variable queueChanged;
+    std::deque<WriteRequest> writeQueue;
+
+    // Display values before the command being applied, for the cells it changed. Once it is done the
+    // clients are sent those whose value differs, so stale markers and unchanged results are not sent.
+    std::unordered_map<CellAddress, std::optional<std::string>> changedCells;
+
+    void serveClient(std::shared_ptr<Client> client);
+    void joinFinishedThreads();
+    void handleLine(const std::shared_ptr<Client>& client, const std::string& line);
+    void handleRead(Client& client, const std::string& target);
+    void runWriter();
+    void applyWrite(const WriteRequest& request);
+
+    void send(Client& client, const std::string& text);
+    void broadcast(const std::string& text);
+};
@@ -1,11 +1,18 @@
 #pragma once
 
+#include <cstddef>
+
 enum class Alignment {
     Left,
     Center,
     Right
 };
 
+enum class CalculationMode {
+    Automatic, // recalculate after every command
+    Manual     // recalculate on the 'calc' command
+};
+
 struct TableConfiguration {
     int initialTableRows;
     int initialTableCols;
@@ -15,4 +22,10 @@ struct TableConfiguration {
     int visibleCellSymbols;
     Alignment initialAlignment;
     bool clearConsoleAfterCommand;
+
+    // Optional recalculation tuning
+    CalculationMode calculationMode = CalculationMode::Automatic;
+    int recalcThreads = 1;
+    size_t evaluationCacheSize = 100000; // resolved cell values memoized per evaluation, 0 disables the cache
+    int recalcTimeBudgetMs = 10;      // evaluation time before a worker lets edits through and resumes
 };
\ No newline at end of file
@@ -2,7 +2,9 @@
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
+#include <algorithm>
 #include <cctype>
+#include <limits>
 #include <map>
 #include <iostream>
 
@@ -61,28 +63,16 @@ void TableConfigurationParser::parseFile(const std::string& filePath) {
 
 void TableConfigurationParser::validateAndSet(const std::string& name, const std::string& value) {
     if (name == "initialTableRows") {
-        if (!isPositiveInteger(value)) {
-            throw std::runtime_error("ABORTING! initialTableRows:" + value + " - Invalid value!");
-        }
-        config.initialTableRows = std::stoi(value);
+        config.initialTableRows = static_cast<int>(parseInteger(name, value, 1, std::numeric_limits<int>::max()));
     }
     else if (name == "initialTableCols") {
-        if (!isPositiveInteger(value)) {
-            throw std::runtime_error("ABORTING! initialTableCols:" + value + " - Invalid value!");
-        }
-        config.initialTableCols = std::stoi(value);
+        config.initialTableCols = static_cast<int>(parseInteger(name, value, 1, std::numeric_limits<int>::max()));
     }
     else if (name == "maxTableRows") {
-        if (!isPositiveInteger(value)) {
-            throw std::runtime_error("ABORTING! maxTableRows:" + value + " - Invalid value!");
-        }
-        config.maxTableRows = std::stoi(value);
+        config.maxTableRows = static_cast<int>(parseInteger(name, value, 1, std::numeric_limits<int>::max()));
     }
     else if (name == "maxTableCols") {
-        if (!isPositiveInteger(value)) {
-            throw std::runtime_error("ABORTING! maxTableCols:" + value + " - Invalid value!");
-        }
-        config.maxTableCols = std::stoi(value);
+        config.maxTableCols = static_cast<int>(parseInteger(name, value, 1, std::numeric_limits<int>::max()));
     }
     else if (name == "autoFit") {
         if (!isBoolean(value)) {
@@ -91,10 +81,7 @@ void TableConfigurationParser::validateAndSet(const std::string& name, const std
         config.autoFit = (value == "true");
     }
     else if (name == "visibleCellSymbols") {
-        if (!isPositiveInteger(value)) {
-            throw std::runtime_error("ABORTING! visibleCellSymbols:" + value + " - Invalid value!");
-        }
-        config.visibleCellSymbols = std::stoi(value);
+        config.visibleCellSymbols = static_cast<int>(parseInteger(name, value, 1, std::numeric_limits<int>::max()));
     }
     else if (name == "initialAlignment") {
         config.initialAlignment = parseAlignment(value);
@@ -105,6 +92,18 @@ void TableConfigurationParser::validateAndSet(const std::string& name, const std
         }
         config.clearConsoleAfterCommand = (value == "true");
     }
+    else if (name == "calculationMode") {
+        config.calculationMode = parseCalculationMode(value);
+    }
+    else if (name == "recalcThreads") {
+        config.recalcThreads = static_cast<int>(parseInteger(name, value, 1, 64));
+    }
+    else if (name == "evaluationCacheSize") {
+        config.evaluationCacheSize = static_cast<size_t>(parseInteger(name, value, 0, std::numeric_limits<size_t>::max()));
+    }
+    else if (name == "recalcTimeBudgetMs") {
+        config.recalcTimeBudgetMs = static_cast<int>(parseInteger(name, value, 1, std::numeric_limits<int>::max()));
+    }
     else {
         // Allow unknown properties as mentioned in the config spec
         // Do nothing
@@ -119,12 +118,32 @@ Alignment TableConfigurationParser::parseAlignment(const std::string& value) {
     throw std::runtime_error("ABORTING! initialAlignment:" + value + " - Invalid value!");
 }
 
-bool TableConfigurationParser::isPositiveInteger(const std::string& value) const {
-    if (value.empty()) return false;
-    for (char c : value) {
-        if (!std::isdigit(c)) return false;
+CalculationMode TableConfigurationParser::parseCalculationMode(const std::string& value) {
+    if (value == "automatic") return CalculationMode::Automatic;
+    else if (value == "manual") return CalculationMode::Manual;
+
+    throw std::runtime_error("ABORTING! calculationMode:" + value + " - Invalid value!");
+}
+
+// Digits only, within [min, max]; anything else, including values too large to parse, is an invalid value
+unsigned long long TableConfigurationParser::parseInteger(const std::string& name, const std::string& value,
+    unsigned long long min, unsigned long long max) const {
+    bool digits = !value.empty() && std::all_of(value.begin(), value.end(), [](char c) {
+        return std::isdigit(static_cast<unsigned char>(c)) != 0;
+    });
+
+    unsigned long long number = 0;
+    try {
+        number = digits ? std::stoull(value) : 0;
+    }
+    catch (const std::out_of_range&) {
+        digits = false;
+    }
+
+    if (!digits || number < min || number > max) {
+        throw std::runtime_error("ABORTING! " + name + ":" + value + " - Invalid value!");
     }
-    return std::stoi(value) > 0;
+    return number;
 }
 
 bool TableConfigurationParser::isBoolean(const std::string& value) const {
@@ -17,8 +17,9 @@ private:
     void parseFile(const std::string& filePath);
     void validateAndSet(const std::string& name, const std::string& value);
     Alignment parseAlignment(const std::string& value);
+    CalculationMode parseCalculationMode(const std::string& value);
 
     // Utility validation functions
-    bool isPositiveInteger(const std::string& value) const;
+    unsigned long long parseInteger(const std::string& name, const std::string& value, unsigned long long min, unsigned long long max) const;
     bool isBoolean(const std::string& value) const;
 };
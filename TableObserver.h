@@ -0,0 +1,23 @@
+#pragma once
+
+#include <unordered_set>
+#include "CellAddress.h"
+
+// What changed in the displayable table since the previous notification
+struct ChangeSet {
+    std::unordered_set<CellAddress> cells;        // display value or stale state changed
+    std::unordered_set<size_t> resizedColumns;    // longest value of the column changed
+    bool extentChanged = false;                   // row or column count changed
+    bool viewportChanged = false;
+
+    bool empty() const {
+        return cells.empty() && resizedColumns.empty() && !extentChanged && !viewportChanged;
+    }
+};
+
+// Receives the changes of every handled event, so observers only revisit what changed
+class TableObserver {
+public:
+    virtual ~TableObserver() = default;
+    virtual void tableChanged(const ChangeSet& changes) = 0;
+};
@@ -1,28 +1,56 @@
 #include "TableParser.h"
+#include "EventParser.h"
+#include "TableSnapshotParser.h"
+#include "Tracer.h"
 
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <variant>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+
+static constexpr size_t csvBufferSize = 64 * 1024;
+
+const std::string TableParser::workbookExtension = ".workbook";
 
 // - Inerface
 
 bool TableParser::save(const TableModel& table, const std::string& filename) {
+    TraceSpan span("io", "save");
+    const std::string& snapshotExtension = TableSnapshotParser::fileExtension;
+    if (filename.size() > snapshotExtension.size() &&
+        filename.compare(filename.size() - snapshotExtension.size(), snapshotExtension.size(), snapshotExtension) == 0) {
+        return TableSnapshotParser::save(table, filename);
+    }
+
     std::ofstream outputFile(filename);
     if (!outputFile.is_open()) {
         std::cerr << "Error opening file for saving: " << filename << std::endl;
         return false;
     }
 
-    for (const auto& pair : table.getAllCells()) {
-        outputFile << pair.first.toString() << "=" << serializeCellValue(pair.second) << std::endl;
-    }
-
+    writeCells(table, outputFile);
     outputFile.close();
+    if (outputFile.fail()) {
+        std::cerr << "Error writing table file: " << filename << std::endl;
+        return false;
+    }
     return true;
 }
 
 TableModel TableParser::load(const std::string& filename) {
+    TraceSpan span("io", "load");
+    if (TableSnapshotParser::isSnapshotFile(filename)) {
+        return TableSnapshotParser::load(filename);
+    }
+    if (isWorkbookFile(filename)) {
+        throw std::runtime_error("File holds a workbook, not a single table: " + filename);
+    }
+
     std::ifstream inputFile(filename);
     if (!inputFile.is_open()) {
         throw std::runtime_error("Error opening file for loading: " + filename);
@@ -31,30 +59,418 @@ TableModel TableParser::load(const std::string& filename) {
     TableModel table;
     std::string line;
     while (getline(inputFile, line)) {
-        size_t equalsPos = line.find('=');
-        if (equalsPos != std::string::npos) {
-            std::string addressStr = line.substr(0, equalsPos);
-            std::string valueStr = line.substr(equalsPos + 1);
-            try {
-                CellAddress address = CellAddress::fromString(addressStr);
-                if (auto cell_value = deserializeCellValue(valueStr)) {
-                    table.setCellValue(address, *cell_value);
+        readLine(table, line);
+    }
+
+    inputFile.close();
+    return table;
+}
+
+// - Workbooks
+// The cells of each sheet follow a [{name}] line, in the same format as a table file.
+
+bool TableParser::hasWorkbookExtension(const std::string& filename) {
+    return filename.size() > workbookExtension.size() &&
+        filename.compare(filename.size() - workbookExtension.size(), workbookExtension.size(), workbookExtension) == 0;
+}
+
+bool TableParser::isWorkbookFile(const std::string& filename) {
+    std::ifstream inputFile(filename);
+    return inputFile.is_open() && inputFile.peek() == '[';
+}
+
+bool TableParser::saveWorkbook(const std::vector<std::pair<std::string, const TableModel*>>& sheets, const std::string& filename) {
+    TraceSpan span("io", "save");
+    std::ofstream outputFile(filename);
+    if (!outputFile.is_open()) {
+        std::cerr << "Error opening file for saving: " << filename << std::endl;
+        return false;
+    }
+
+    for (const auto& [name, table] : sheets) {
+        outputFile << "[" << name << "]\n";
+        writeCells(*table, outputFile);
+    }
+
+    outputFile.close();
+    if (outputFile.fail()) {
+        std::cerr << "Error writing table file: " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::vector<std::pair<std::string, TableModel>> TableParser::loadWorkbook(const std::string& filename) {
+    TraceSpan span("io", "load");
+    std::ifstream inputFile(filename);
+    if (!inputFile.is_open()) {
+        throw std::runtime_error("Error opening file for loading: " + filename);
+    }
+
+    std::vector<std::pair<std::string, TableModel>> sheets;
+    std::string line;
+    while (getline(inputFile, line)) {
+        if (line.size() > 2 && line.front() == '[' && line.back() == ']') {
+            sheets.emplace_back(line.substr(1, line.size() - 2), TableModel());
+        }
+        else if (sheets.empty()) {
+            std::cerr << "Warning: Cell outside of any sheet: " << line << std::endl;
+        }
+        else {
+            readLine(sheets.back().second, line);
+        }
+    }
+
+    inputFile.close();
+    return sheets;
+}
+
+void TableParser::writeCells(const TableModel& table, std::ostream& output) {
+    // Formula cells are grouped by their relative body, so a formula filled over many cells is written once
+    std::unordered_map<std::string, std::vector<CellAddress>> sharedFormulas;
+
+    for (const auto& pair : table.getAllCells()) {
+        if (auto val = std::get_if<FormulaValue>(&pair.second.value)) {
+            sharedFormulas[serializeSharedFormula(*val, pair.first)].push_back(pair.first);
+        }
+        else {
+            output << pair.first.toString() << "=" << serializeCellValue(pair.second) << "\n";
+        }
+    }
+
+    // Formulas with no relative twin may still be textually identical to others
+    std::unordered_map<std::string, std::vector<CellAddress>> identicalFormulas;
+
+    for (const auto& [body, targets] : sharedFormulas) {
+        if (targets.size() == 1) {
+            const CellValue* cellValue = table.getCellValue(targets.front());
+            identicalFormulas[serializeCellValue(*cellValue)].push_back(targets.front());
+        }
+        else {
+            output << serializeTargetList(targets) << "=" << body << "\n";
+        }
+    }
+
+    for (const auto& [body, targets] : identicalFormulas) {
+        output << serializeTargetList(targets) << "=" << body << "\n";
+    }
+}
+
+void TableParser::readLine(TableModel& table, const std::string& line) {
+    size_t equalsPos = line.find('=');
+    if (equalsPos == std::string::npos) {
+        std::cerr << "Warning: Invalid line format: " << line << std::endl;
+        return;
+    }
+
+    std::string addressStr = line.substr(0, equalsPos);
+    std::string valueStr = line.substr(equalsPos + 1);
+    try {
+        if (valueStr.rfind("shared:", 0) == 0) {
+            // The shared body is parsed once, each target gets its own copy shifted onto it
+            auto sharedFormula = deserializeSharedFormula(valueStr);
+            auto targets = deserializeTargetList(addressStr);
+            if (sharedFormula && targets) {
+                for (const auto& target : *targets) {
+                    table.setCellValue(target, CellValue{ instantiateSharedFormula(*sharedFormula, target) });
                 }
-                else {
-                    std::cerr << "Warning: Could not deserialize value: " << valueStr << " for cell " << addressStr << std::endl;
+            }
+            else {
+                std::cerr << "Warning: Could not deserialize shared formula: " << valueStr << " for cells " << addressStr << std::endl;
+            }
+            return;
+        }
+
+        if (addressStr.find_first_of(",-") != std::string::npos) {
+            // Identical value written once for a list of cells
+            auto cell_value = deserializeCellValue(valueStr);
+            auto targets = deserializeTargetList(addressStr);
+            if (cell_value && targets) {
+                for (const auto& target : *targets) {
+                    table.setCellValue(target, *cell_value);
                 }
             }
-            catch (const std::exception& e) {
-                std::cerr << "Warning: Could not parse line: " << line << " (" << e.what() << ")" << std::endl;
+            else {
+                std::cerr << "Warning: Could not deserialize value: " << valueStr << " for cells " << addressStr << std::endl;
             }
+            return;
+        }
+
+        CellAddress address = CellAddress::fromString(addressStr);
+        if (auto cell_value = deserializeCellValue(valueStr)) {
+            table.setCellValue(address, *cell_value);
         }
         else {
-            std::cerr << "Warning: Invalid line format: " << line << std::endl;
+            std::cerr << "Warning: Could not deserialize value: " << valueStr << " for cell " << addressStr << std::endl;
         }
     }
+    catch (const std::exception& e) {
+        std::cerr << "Warning: Could not parse line: " << line << " (" << e.what() << ")" << std::endl;
+    }
+}
 
-    inputFile.close();
-    return table;
+// - CSV
+
+size_t TableParser::importCsv(TableModel& table, const std::string& filename) {
+    return importCsv(filename, [&table](const CellAddress& address, CellValue value) {
+        table.setCellValue(address, std::move(value));
+    });
+}
+
+size_t TableParser::importCsv(const std::string& filename, const CellSink& setCell) {
+    TraceSpan span("io", "import");
+    std::ifstream inputFile(filename, std::ios::binary);
+    if (!inputFile.is_open()) {
+        throw std::runtime_error("Error opening file for import: " + filename);
+    }
+
+    std::vector<char> buffer(csvBufferSize);
+    std::string field;
+    size_t row = 0;
+    size_t column = 0;
+    size_t imported = 0;
+    bool inQuotes = false;
+    bool quoteClosed = false;
+    bool quoted = false;
+
+    // Quoting marks a field as text (RFC 4180), only unquoted fields have their type inferred
+    auto endField = [&]() {
+        if (!field.empty()) {
+            CellAddress address{ row, column };
+            if (quoted && field.front() == '\'') {
+                setCell(address, CellValue{ LiteralValue{ field.substr(1) } });
+                ++imported;
+            }
+            else if (quoted && field.front() != '=') {
+                setCell(address, CellValue{ LiteralValue{ field } });
+                ++imported;
+            }
+            else if (auto cell_value = inferCsvCellValue(address, field)) {
+                setCell(address, std::move(*cell_value));
+                ++imported;
+            }
+        }
+        field.clear();
+        quoted = false;
+        ++column;
+    };
+
+    auto endRow = [&]() {
+        endField();
+        ++row;
+        column = 0;
+    };
+
+    while (inputFile) {
+        inputFile.read(buffer.data(), buffer.size());
+        std::streamsize bytesRead = inputFile.gcount();
+
+        for (std::streamsize i = 0; i < bytesRead; ++i) {
+            char c = buffer[i];
+
+            if (inQuotes) {
+                if (c == '"') {
+                    inQuotes = false;
+                    quoteClosed = true;
+                }
+                else {
+                    field += c;
+                }
+                continue;
+            }
+
+            if (c == '"') {
+                if (quoteClosed) {
+                    // Escaped quote ("") inside a quoted field
+                    field += c;
+                    inQuotes = true;
+                }
+                else if (field.empty()) {
+                    inQuotes = true;
+                    quoted = true;
+                }
+                else {
+                    field += c;
+                }
+                quoteClosed = false;
+                continue;
+            }
+
+            quoteClosed = false;
+            if (c == ',') {
+                endField();
+            }
+            else if (c == '\n') {
+                endRow();
+            }
+            else if (c != '\r') {
+                field += c;
+            }
+        }
+    }
+
+    // Last row without a trailing newline
+    if (column > 0 || !field.empty()) {
+        endRow();
+    }
+
+    return imported;
+}
+
+bool TableParser::exportCsv(const TableModel& table, const DisplayableTableModel& displayableTable, const std::string& filename, bool evaluated) {
+    TraceSpan span("io", "export");
+    std::ofstream outputFile(filename, std::ios::binary);
+    if (!outputFile.is_open()) {
+        std::cerr << "Error opening file for export: " << filename << std::endl;
+        return false;
+    }
+
+    if (table.getAllCells().empty()) {
+        return true;
+    }
+
+    size_t rows = displayableTable.getRowCount();
+    size_t columns = displayableTable.getColumnCount();
+
+    std::string buffer;
+    buffer.reserve(csvBufferSize * 2);
+
+    for (size_t row = 0; row < rows; ++row) {
+        for (size_t column = 0; column < columns; ++column) {
+            if (column > 0) {
+                buffer += ',';
+            }
+
+            CellAddress address{ row, column };
+            if (evaluated) {
+                if (const std::string* value = displayableTable.getDisplayValue(address)) {
+                    appendCsvField(buffer, *value);
+                }
+            }
+            else if (const CellValue* cellValue = table.getCellValue(address)) {
+                // Text is quoted, so "0123" is imported back as text, and "'=A1" tells it from a formula
+                auto literal = std::get_if<LiteralValue>(&cellValue->value);
+                bool text = literal && std::holds_alternative<std::string>(literal->value);
+                std::string field = formatRawCellValue(*cellValue);
+                if (text && !field.empty() && (field.front() == '=' || field.front() == '\'')) {
+                    field.insert(field.begin(), '\'');
+                }
+                appendCsvField(buffer, field, text);
+            }
+        }
+        buffer += '\n';
+
+        if (buffer.size() >= csvBufferSize) {
+            outputFile.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+
+    outputFile.write(buffer.data(), buffer.size());
+    return static_cast<bool>(outputFile);
+}
+
+std::optional<CellValue> TableParser::inferCsvCellValue(const CellAddress& address, const std::string& field) {
+    // Fields starting with '=' hold references and formulas in the command syntax
+    if (field.front() == '=') {
+        try {
+            Event event = EventParser::parse(address.toString() + field);
+            if (auto e = std::get_if<ReferenceEvent>(&event)) {
+                return e->sheet ? CellValue{ SheetAddress{ *e->sheet, e->source } } : CellValue{ e->source };
+            }
+            else if (auto e = std::get_if<FormulaEvent>(&event)) {
+                return CellValue{ FormulaValue{ e->formula, e->params } };
+            }
+        }
+        catch (...) {
+            // Not a formula after all, keep it as text
+        }
+        return CellValue{ LiteralValue{ field } };
+    }
+
+    if (field == "TRUE" || field == "FALSE") {
+        return CellValue{ LiteralValue{ field == "TRUE" } };
+    }
+
+    bool looksNumeric = std::isdigit(static_cast<unsigned char>(field.front())) || field.front() == '-' || field.front() == '+' || field.front() == '.';
+    if (looksNumeric && field.find_first_not_of("0123456789+-.eE") == std::string::npos) {
+        char* end = nullptr;
+        double number = std::strtod(field.c_str(), &end);
+        if (end == field.c_str() + field.size()) {
+            return CellValue{ LiteralValue{ number } };
+        }
+    }
+
+    return CellValue{ LiteralValue{ field } };
+}
+
+std::string TableParser::formatRawLiteralValue(const LiteralValue& lv) {
+    if (auto val = std::get_if<double>(&lv.value)) {
+        char number[32];
+        std::snprintf(number, sizeof(number), "%.15g", *val);
+        return number;
+    }
+    else if (auto val = std::get_if<bool>(&lv.value)) {
+        return *val ? "TRUE" : "FALSE";
+    }
+    else if (auto val = std::get_if<std::string>(&lv.value)) {
+        return *val;
+    }
+    return "";
+}
+
+std::string TableParser::formatRawCellValue(const CellValue& cv) {
+    if (auto val = std::get_if<LiteralValue>(&cv.value)) {
+        return formatRawLiteralValue(*val);
+    }
+    else if (auto val = std::get_if<CellAddress>(&cv.value)) {
+        return "=" + val->toString();
+    }
+    else if (auto val = std::get_if<SheetAddress>(&cv.value)) {
+        return "=" + val->sheet + "!" + val->address.toString();
+    }
+    else if (auto val = std::get_if<FormulaValue>(&cv.value)) {
+        std::string paramsStr;
+        for (size_t i = 0; i < val->parameters.size(); ++i) {
+            const FormulaParam& fp = val->parameters[i];
+            if (auto param = std::get_if<LiteralValue>(&fp)) {
+                paramsStr += formatRawLiteralValue(*param);
+            }
+            else if (auto param = std::get_if<CellAddress>(&fp)) {
+                paramsStr += param->toString();
+            }
+            else if (auto param = std::get_if<AddressRange>(&fp)) {
+                paramsStr += param->start.toString() + ":" + param->end.toString();
+            }
+            else if (auto param = std::get_if<SheetAddress>(&fp)) {
+                paramsStr += param->sheet + "!" + param->address.toString();
+            }
+            else if (auto param = std::get_if<SheetRange>(&fp)) {
+                paramsStr += param->sheet + "!" + param->range.start.toString() + ":" + param->range.end.toString();
+            }
+            if (i < val->parameters.size() - 1) {
+                paramsStr += ",";
+            }
+        }
+        return "=" + serializeFormulaType(val->type) + "(" + paramsStr + ")";
+    }
+    return "";
+}
+
+void TableParser::appendCsvField(std::string& buffer, const std::string& field, bool quote) {
+    if (!quote && field.find_first_of(",\"\r\n") == std::string::npos) {
+        buffer += field;
+        return;
+    }
+
+    buffer += '"';
+    for (char c : field) {
+        if (c == '"') {
+            buffer += '"';
+        }
+        buffer += c;
+    }
+    buffer += '"';
 }
 
 // - Literal Values
@@ -105,6 +521,12 @@ std::string TableParser::serializeFormulaParam(const FormulaParam& fp) {
     else if (auto val = std::get_if<AddressRange>(&fp)) {
         return "range:" + val->start.toString() + "-" + val->end.toString();
     }
+    else if (auto val = std::get_if<SheetAddress>(&fp)) {
+        return "sheetcell:" + val->sheet + "!" + val->address.toString();
+    }
+    else if (auto val = std::get_if<SheetRange>(&fp)) {
+        return "sheetrange:" + val->sheet + "!" + val->range.start.toString() + "-" + val->range.end.toString();
+    }
     return "";
 }
 
@@ -135,11 +557,62 @@ std::optional<FormulaParam> TableParser::deserializeFormulaParam(const std::stri
             }
         }
     }
+    else if (s.rfind("sheetcell:", 0) == 0) {
+        size_t bangPos = s.find('!');
+        if (bangPos != std::string::npos) {
+            try {
+                return SheetAddress{ s.substr(10, bangPos - 10), CellAddress::fromString(s.substr(bangPos + 1)) };
+            }
+            catch (...) {
+                return std::nullopt;
+            }
+        }
+    }
+    else if (s.rfind("sheetrange:", 0) == 0) {
+        size_t bangPos = s.find('!');
+        size_t dashPos = s.find('-', bangPos);
+        if (bangPos != std::string::npos && dashPos != std::string::npos) {
+            try {
+                CellAddress start = CellAddress::fromString(s.substr(bangPos + 1, dashPos - bangPos - 1));
+                CellAddress end = CellAddress::fromString(s.substr(dashPos + 1));
+                return SheetRange{ s.substr(11, bangPos - 11), AddressRange{ start, end } };
+            }
+            catch (...) {
+                return std::nullopt;
+            }
+        }
+    }
     return std::nullopt;
 }
 
 // - FormulaValue
 
+std::string TableParser::serializeFormulaType(FormulaType type) {
+    switch (type) {
+    case FormulaType::SUM: return "SUM";
+    case FormulaType::AVERAGE: return "AVERAGE";
+    case FormulaType::MIN: return "MIN";
+    case FormulaType::MAX: return "MAX";
+    case FormulaType::CONCAT: return "CONCAT";
+    case FormulaType::SUBSTR: return "SUBSTR";
+    case FormulaType::LEN: return "LEN";
+    case FormulaType::COUNT: return "COUNT";
+    }
+    return "";
+}
+
+std::optional<FormulaType> TableParser::deserializeFormulaType(const std::string& s) {
+    if (s == "SUM") return FormulaType::SUM;
+    else if (s == "AVERAGE") return FormulaType::AVERAGE;
+    else if (s == "MIN") return FormulaType::MIN;
+    else if (s == "MAX") return FormulaType::MAX;
+    else if (s == "CONCAT") return FormulaType::CONCAT;
+    else if (s == "SUBSTR") return FormulaType::SUBSTR;
+    else if (s == "LEN") return FormulaType::LEN;
+    else if (s == "COUNT") return FormulaType::COUNT;
+    return std::nullopt;
+}
+
 std::string TableParser::serializeFormulaValue(const FormulaValue& fv) {
     std::string paramsStr;
     for (size_t i = 0; i < fv.parameters.size(); ++i) {
@@ -148,18 +621,7 @@ std::string TableParser::serializeFormulaValue(const FormulaValue& fv) {
             paramsStr += ",";
         }
     }
-    std::string formulaTypeStr;
-    switch (fv.type) {
-    case FormulaType::SUM: formulaTypeStr = "SUM"; break;
-    case FormulaType::AVERAGE: formulaTypeStr = "AVERAGE"; break;
-    case FormulaType::MIN: formulaTypeStr = "MIN"; break;
-    case FormulaType::MAX: formulaTypeStr = "MAX"; break;
-    case FormulaType::CONCAT: formulaTypeStr = "CONCAT"; break;
-    case FormulaType::SUBSTR: formulaTypeStr = "SUBSTR"; break;
-    case FormulaType::LEN: formulaTypeStr = "LEN"; break;
-    case FormulaType::COUNT: formulaTypeStr = "COUNT"; break;
-    }
-    return "formula:" + formulaTypeStr + "(" + paramsStr + ")";
+    return "formula:" + serializeFormulaType(fv.type) + "(" + paramsStr + ")";
 }
 
 std::optional<FormulaValue> TableParser::deserializeFormulaValue(const std::string& s) {
@@ -171,16 +633,8 @@ std::optional<FormulaValue> TableParser::deserializeFormulaValue(const std::stri
             std::string typeStr = content.substr(0, openParen);
             std::string paramsStr = content.substr(openParen + 1, closeParen - openParen - 1);
 
-            FormulaType type;
-            if (typeStr == "SUM") type = FormulaType::SUM;
-            else if (typeStr == "AVERAGE") type = FormulaType::AVERAGE;
-            else if (typeStr == "MIN") type = FormulaType::MIN;
-            else if (typeStr == "MAX") type = FormulaType::MAX;
-            else if (typeStr == "CONCAT") type = FormulaType::CONCAT;
-            else if (typeStr == "SUBSTR") type = FormulaType::SUBSTR;
-            else if (typeStr == "LEN") type = FormulaType::LEN;
-            else if (typeStr == "COUNT") type = FormulaType::COUNT;
-            else return std::nullopt;
+            auto type = deserializeFormulaType(typeStr);
+            if (!type) return std::nullopt;
 
             std::vector<FormulaParam> params;
             std::stringstream ss(paramsStr);
@@ -193,7 +647,7 @@ std::optional<FormulaValue> TableParser::deserializeFormulaValue(const std::stri
                     return std::nullopt;
                 }
             }
-            return FormulaValue{ type, params };
+            return FormulaValue{ *type, params };
         }
     }
     return std::nullopt;
@@ -208,6 +662,9 @@ std::string TableParser::serializeCellValue(const CellValue& cv) {
     else if (auto val = std::get_if<CellAddress>(&cv.value)) {
         return "reference:" + val->toString();
     }
+    else if (auto val = std::get_if<SheetAddress>(&cv.value)) {
+        return "sheetreference:" + val->sheet + "!" + val->address.toString();
+    }
     else if (auto val = std::get_if<FormulaValue>(&cv.value)) {
         return serializeFormulaValue(*val);
     }
@@ -228,10 +685,255 @@ std::optional<CellValue> TableParser::deserializeCellValue(const std::string& s)
             return std::nullopt;
         }
     }
+    else if (s.rfind("sheetreference:", 0) == 0) {
+        size_t bangPos = s.find('!');
+        if (bangPos != std::string::npos) {
+            try {
+                return CellValue{ SheetAddress{ s.substr(15, bangPos - 15), CellAddress::fromString(s.substr(bangPos + 1)) } };
+            }
+            catch (...) {
+                return std::nullopt;
+            }
+        }
+    }
     else if (s.rfind("formula:", 0) == 0) {
         if (auto fv = deserializeFormulaValue(s)) {
             return CellValue{ *fv };
         }
     }
     return std::nullopt;
-}
\ No newline at end of file
+}
+
+// - Shared Formulas
+
+std::string TableParser::serializeRelativeAddress(const RelativeAddress& ra) {
+    return "R[" + std::to_string(ra.rowOffset) + "]C[" + std::to_string(ra.columnOffset) + "]";
+}
+
+std::optional<TableParser::RelativeAddress> TableParser::deserializeRelativeAddress(const std::string& s) {
+    // Expected format: R[{rowOffset}]C[{columnOffset}]
+    size_t columnPos = s.find("]C[");
+    if (s.rfind("R[", 0) != 0 || columnPos == std::string::npos || s.back() != ']') {
+        return std::nullopt;
+    }
+    try {
+        size_t rowLength = 0;
+        size_t columnLength = 0;
+        std::string rowStr = s.substr(2, columnPos - 2);
+        std::string columnStr = s.substr(columnPos + 3, s.length() - columnPos - 4);
+        long long rowOffset = std::stoll(rowStr, &rowLength);
+        long long columnOffset = std::stoll(columnStr, &columnLength);
+        if (rowLength != rowStr.length() || columnLength != columnStr.length()) {
+            return std::nullopt;
+        }
+        return RelativeAddress{ rowOffset, columnOffset };
+    }
+    catch (...) {
+        return std::nullopt;
+    }
+}
+
+std::string TableParser::serializeSharedFormula(const FormulaValue& fv, const CellAddress& anchor) {
+    auto relativeTo = [&anchor](const CellAddress& address) {
+        return RelativeAddress{
+            static_cast<long long>(address.row) - static_cast<long long>(anchor.row),
+            static_cast<long long>(address.column) - static_cast<long long>(anchor.column)
+        };
+    };
+
+    std::string paramsStr;
+    for (size_t i = 0; i < fv.parameters.size(); ++i) {
+        const FormulaParam& fp = fv.parameters[i];
+        if (auto val = std::get_if<CellAddress>(&fp)) {
+            paramsStr += "rcell:" + serializeRelativeAddress(relativeTo(*val));
+        }
+        else if (auto val = std::get_if<AddressRange>(&fp)) {
+            paramsStr += "rrange:" + serializeRelativeAddress(relativeTo(val->start)) + ":" + serializeRelativeAddress(relativeTo(val->end));
+        }
+        else if (auto val = std::get_if<SheetAddress>(&fp)) {
+            paramsStr += "rsheetcell:" + val->sheet + "!" + serializeRelativeAddress(relativeTo(val->address));
+        }
+        else if (auto val = std::get_if<SheetRange>(&fp)) {
+            paramsStr += "rsheetrange:" + val->sheet + "!" + serializeRelativeAddress(relativeTo(val->range.start)) + ":" +
+                serializeRelativeAddress(relativeTo(val->range.end));
+        }
+        else {
+            paramsStr += serializeFormulaParam(fp);
+        }
+        if (i < fv.parameters.size() - 1) {
+            paramsStr += ",";
+        }
+    }
+    return "shared:" + serializeFormulaType(fv.type) + "(" + paramsStr + ")";
+}
+
+std::optional<TableParser::SharedFormula> TableParser::deserializeSharedFormula(const std::string& s) {
+    if (s.rfind("shared:", 0) != 0) {
+        return std::nullopt;
+    }
+
+    std::string content = s.substr(7);
+    size_t openParen = content.find('(');
+    size_t closeParen = content.find(')');
+    if (openParen == std::string::npos || closeParen == std::string::npos || openParen > closeParen) {
+        return std::nullopt;
+    }
+
+    auto type = deserializeFormulaType(content.substr(0, openParen));
+    if (!type) return std::nullopt;
+
+    std::vector<SharedFormulaParam> params;
+    std::stringstream ss(content.substr(openParen + 1, closeParen - openParen - 1));
+    std::string paramToken;
+    while (getline(ss, paramToken, ',')) {
+        if (paramToken.rfind("rcell:", 0) == 0) {
+            auto address = deserializeRelativeAddress(paramToken.substr(6));
+            if (!address) return std::nullopt;
+            params.push_back(*address);
+        }
+        else if (paramToken.rfind("rrange:", 0) == 0) {
+            size_t colonPos = paramToken.find(':', 7);
+            if (colonPos == std::string::npos) return std::nullopt;
+            auto start = deserializeRelativeAddress(paramToken.substr(7, colonPos - 7));
+            auto end = deserializeRelativeAddress(paramToken.substr(colonPos + 1));
+            if (!start || !end) return std::nullopt;
+            params.push_back(RelativeRange{ *start, *end });
+        }
+        else if (paramToken.rfind("rsheetcell:", 0) == 0) {
+            size_t bangPos = paramToken.find('!');
+            if (bangPos == std::string::npos) return std::nullopt;
+            auto address = deserializeRelativeAddress(paramToken.substr(bangPos + 1));
+            if (!address) return std::nullopt;
+            params.push_back(RelativeSheetAddress{ paramToken.substr(11, bangPos - 11), *address });
+        }
+        else if (paramToken.rfind("rsheetrange:", 0) == 0) {
+            size_t bangPos = paramToken.find('!');
+            size_t colonPos = paramToken.find(':', bangPos);
+            if (bangPos == std::string::npos || colonPos == std::string::npos) return std::nullopt;
+            auto start = deserializeRelativeAddress(paramToken.substr(bangPos + 1, colonPos - bangPos - 1));
+            auto end = deserializeRelativeAddress(paramToken.substr(colonPos + 1));
+            if (!start || !end) return std::nullopt;
+            params.push_back(RelativeSheetRange{ paramToken.substr(12, bangPos - 12), RelativeRange{ *start, *end } });
+        }
+        else if (paramToken.rfind("literal:", 0) == 0) {
+            auto lv = deserializeLiteralValue(paramToken.substr(8));
+            if (!lv) return std::nullopt;
+            params.push_back(*lv);
+        }
+        else {
+            return std::nullopt;
+        }
+    }
+    return SharedFormula{ *type, params };
+}
+
+FormulaValue TableParser::instantiateSharedFormula(const SharedFormula& sf, const CellAddress& anchor) {
+    std::vector<FormulaParam> params;
+    params.reserve(sf.parameters.size());
+
+    for (const auto& param : sf.parameters) {
+        if (auto val = std::get_if<LiteralValue>(&param)) {
+            params.push_back(*val);
+        }
+        else if (auto val = std::get_if<RelativeAddress>(&param)) {
+            params.push_back(anchor.offsetBy(val->rowOffset, val->columnOffset));
+        }
+        else if (auto val = std::get_if<RelativeRange>(&param)) {
+            params.push_back(AddressRange{
+                anchor.offsetBy(val->start.rowOffset, val->start.columnOffset),
+                anchor.offsetBy(val->end.rowOffset, val->end.columnOffset)
+                });
+        }
+        else if (auto val = std::get_if<RelativeSheetAddress>(&param)) {
+            params.push_back(SheetAddress{ val->sheet, anchor.offsetBy(val->address.rowOffset, val->address.columnOffset) });
+        }
+        else if (auto val = std::get_if<RelativeSheetRange>(&param)) {
+            params.push_back(SheetRange{ val->sheet, AddressRange{
+                anchor.offsetBy(val->range.start.rowOffset, val->range.start.columnOffset),
+                anchor.offsetBy(val->range.end.rowOffset, val->range.end.columnOffset)
+                } });
+        }
+    }
+    return FormulaValue{ sf.type, params };
+}
+
+// Targets are written as a comma separated list of single cells and rectangular blocks ({start}-{end})
+std::string TableParser::serializeTargetList(std::vector<CellAddress> targets) {
+    struct Block {
+        CellAddress start;
+        CellAddress end;
+    };
+
+    // Merge consecutive rows of the same column into vertical runs
+    std::sort(targets.begin(), targets.end(), [](const CellAddress& a, const CellAddress& b) {
+        return a.column != b.column ? a.column < b.column : a.row < b.row;
+        });
+
+    std::vector<Block> runs;
+    for (const auto& target : targets) {
+        if (!runs.empty() && runs.back().end.column == target.column && runs.back().end.row + 1 == target.row) {
+            runs.back().end = target;
+        }
+        else {
+            runs.push_back(Block{ target, target });
+        }
+    }
+
+    // Merge runs spanning the same rows in consecutive columns into blocks
+    std::sort(runs.begin(), runs.end(), [](const Block& a, const Block& b) {
+        if (a.start.row != b.start.row) return a.start.row < b.start.row;
+        if (a.end.row != b.end.row) return a.end.row < b.end.row;
+        return a.start.column < b.start.column;
+        });
+
+    std::vector<Block> blocks;
+    for (const auto& run : runs) {
+        if (!blocks.empty() && blocks.back().start.row == run.start.row && blocks.back().end.row == run.end.row &&
+            blocks.back().end.column + 1 == run.start.column) {
+            blocks.back().end = run.end;
+        }
+        else {
+            blocks.push_back(run);
+        }
+    }
+
+    std::string result;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        result += blocks[i].start.toString();
+        if (!(blocks[i].start == blocks[i].end)) {
+            result += "-" + blocks[i].end.toString();
+        }
+        if (i < blocks.size() - 1) {
+            result += ",";
+        }
+    }
+    return result;
+}
+
+std::optional<std::vector<CellAddress>> TableParser::deserializeTargetList(const std::string& s) {
+    std::vector<CellAddress> targets;
+    std::stringstream ss(s);
+    std::string targetToken;
+
+    try {
+        while (getline(ss, targetToken, ',')) {
+            size_t dashPos = targetToken.find('-');
+            if (dashPos == std::string::npos) {
+                targets.push_back(CellAddress::fromString(targetToken));
+                continue;
+            }
+
+            CellAddress start = CellAddress::fromString(targetToken.substr(0, dashPos));
+            CellAddress end = CellAddress::fromString(targetToken.substr(dashPos + 1));
+            for (size_t row = std::min(start.row, end.row); row <= std::max(start.row, end.row); ++row) {
+                for (size_t column = std::min(start.column, end.column); column <= std::max(start.column, end.column); ++column) {
+                    targets.push_back(CellAddress{ row, column });
+                }
+            }
+        }
+    }
+    catch (...) {
+        return std::nullopt;
+    }
+    return targets;
+}
@@ -1,24 +1,104 @@
 #pragma once
 
 #include "TableModel.h"
+#include "DisplayableTableModel.h"
+#include <ostream>
 #include <string>
+#include <functional>
 #include <optional>
+#include <utility>
+#include <variant>
+#include <vector>
 
 class TableParser {
 public:
+    // Files with the snapshot extension are saved as compressed snapshots, which load() recognizes by content
     static bool save(const TableModel& table, const std::string& filename);
     static TableModel load(const std::string& filename);
 
+    // Workbook files hold several named sheets; isWorkbookFile() recognizes them by content, load() rejects them
+    static const std::string workbookExtension;
+    static bool hasWorkbookExtension(const std::string& filename);
+    static bool isWorkbookFile(const std::string& filename);
+    static bool saveWorkbook(const std::vector<std::pair<std::string, const TableModel*>>& sheets, const std::string& filename);
+    static std::vector<std::pair<std::string, TableModel>> loadWorkbook(const std::string& filename);
+
+    // CSV is streamed through a fixed-size buffer, rows map to table rows and fields to columns.
+    // Quoted fields are imported as text, the type of the others is inferred; raw exports quote text.
+    // Quoted fields starting with '=' are formulas quoted for their commas, a leading apostrophe marks text
+    // starting with '=' instead and is dropped on import.
+    // The sink receives each cell as soon as its field is parsed, so nothing but the buffer is held
+    using CellSink = std::function<void(const CellAddress&, CellValue)>;
+    static size_t importCsv(TableModel& table, const std::string& filename);
+    static size_t importCsv(const std::string& filename, const CellSink& setCell);
+    static bool exportCsv(const TableModel& table, const DisplayableTableModel& displayableTable, const std::string& filename, bool evaluated);
+
 private:
+    friend class TableSnapshotParser;
+
+    // - Shared formulas
+    // Formulas which only differ by a relative shift (e.g. filled down a column) are written once,
+    // with their cell parameters stored as R1C1-style offsets from each target cell.
+    // The sharing is in the file only: loading gives every target its own absolute FormulaValue,
+    // as the dependency graph, the evaluator and editing all work on absolute parameters.
+
+    struct RelativeAddress {
+        long long rowOffset;
+        long long columnOffset;
+    };
+
+    struct RelativeRange {
+        RelativeAddress start;
+        RelativeAddress end;
+    };
+
+    struct RelativeSheetAddress {
+        std::string sheet;
+        RelativeAddress address;
+    };
+
+    struct RelativeSheetRange {
+        std::string sheet;
+        RelativeRange range;
+    };
+
+    using SharedFormulaParam = std::variant<LiteralValue, RelativeAddress, RelativeRange, RelativeSheetAddress, RelativeSheetRange>;
+
+    struct SharedFormula {
+        FormulaType type;
+        std::vector<SharedFormulaParam> parameters;
+    };
+
+    static void writeCells(const TableModel& table, std::ostream& output);
+    static void readLine(TableModel& table, const std::string& line);
+
     static std::string serializeLiteralValue(const LiteralValue& lv);
     static std::optional<LiteralValue> deserializeLiteralValue(const std::string& s);
-    
+
     static std::string serializeFormulaParam(const FormulaParam& fp);
     static std::optional<FormulaParam> deserializeFormulaParam(const std::string& s);
-    
+
+    static std::string serializeFormulaType(FormulaType type);
+    static std::optional<FormulaType> deserializeFormulaType(const std::string& s);
+
     static std::string serializeFormulaValue(const FormulaValue& fv);
     static std::optional<FormulaValue> deserializeFormulaValue(const std::string& s);
-    
+
     static std::string serializeCellValue(const CellValue& cv);
     static std::optional<CellValue> deserializeCellValue(const std::string& s);
-};
\ No newline at end of file
+
+    static std::string serializeRelativeAddress(const RelativeAddress& ra);
+    static std::optional<RelativeAddress> deserializeRelativeAddress(const std::string& s);
+
+    static std::string serializeSharedFormula(const FormulaValue& fv, const CellAddress& anchor);
+    static std::optional<SharedFormula> deserializeSharedFormula(const std::string& s);
+    static FormulaValue instantiateSharedFormula(const SharedFormula& sf, const CellAddress& anchor);
+
+    static std::optional<CellValue> inferCsvCellValue(const CellAddress& address, const std::string& field);
+    static std::string formatRawCellValue(const CellValue& cv);
+    static std::string formatRawLiteralValue(const LiteralValue& lv);
+    static void appendCsvField(std::string& buffer, const std::string& field, bool quote = false);
+
+    static std::string serializeTargetList(std::vector<CellAddress> targets);
+    static std::optional<std::vector<CellAddress>> deserializeTargetList(const std::string& s);
+};
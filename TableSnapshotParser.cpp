@@ -0,0 +1,420 @@
+#include "TableSnapshotParser.h"
+#include "TableParser.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <unordered_map>
+#include <optional>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+static const std::string snapshotMagic = "XLSNAP01";
+
+// Shortest run of identical numbers worth encoding as a repeated run
+static constexpr size_t minRepeatedRun = 3;
+
+const std::string TableSnapshotParser::fileExtension = ".xlsnap";
+
+// - HELPERS
+
+static bool isIntegral(double value) {
+    // Keep -0.0 and anything outside the exactly representable range as raw doubles
+    return value == std::floor(value) && std::fabs(value) <= 9007199254740992.0 && !(value == 0.0 && std::signbit(value));
+}
+
+static size_t repeatedRunLength(const std::vector<double>& numbers, size_t start) {
+    size_t end = start + 1;
+    while (end < numbers.size() && std::memcmp(&numbers[end], &numbers[start], sizeof(double)) == 0) {
+        ++end;
+    }
+    return end - start;
+}
+
+// - Interface
+
+bool TableSnapshotParser::save(const TableModel& table, const std::string& filename) {
+    std::ofstream outputFile(filename, std::ios::binary);
+    if (!outputFile.is_open()) {
+        std::cerr << "Error opening file for saving: " << filename << std::endl;
+        return false;
+    }
+
+    // Group cells into column chunks, ordered by row
+    std::unordered_map<size_t, std::vector<std::pair<size_t, const CellValue*>>> columns;
+    for (const auto& [address, value] : table.getAllCells()) {
+        columns[address.column].push_back({ address.row, &value });
+    }
+
+    std::vector<size_t> columnIndices;
+    columnIndices.reserve(columns.size());
+    for (auto& [column, cells] : columns) {
+        std::sort(cells.begin(), cells.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        columnIndices.push_back(column);
+    }
+    std::sort(columnIndices.begin(), columnIndices.end());
+
+    std::vector<std::string> dictionary;
+    std::unordered_map<std::string, uint64_t> dictionaryIndex;
+    auto intern = [&](const std::string& s) {
+        auto [it, inserted] = dictionaryIndex.emplace(s, dictionary.size());
+        if (inserted) {
+            dictionary.push_back(s);
+        }
+        return it->second;
+    };
+
+    std::string chunks;
+    for (size_t column : columnIndices) {
+        const auto& cells = columns[column];
+
+        std::string tags((cells.size() * 3 + 7) / 8, '\0');
+        std::string rows;
+        std::vector<double> numbers;
+        std::string strings;
+        std::string references;
+        std::string formulas;
+        std::string sheetReferences;
+
+        size_t previousRow = 0;
+        for (size_t i = 0; i < cells.size(); ++i) {
+            const auto& [row, cellValue] = cells[i];
+            CellAddress address{ row, column };
+
+            writeVarint(rows, row - previousRow);
+            previousRow = row;
+
+            CellTag tag = CellTag::Number;
+            if (auto val = std::get_if<LiteralValue>(&cellValue->value)) {
+                if (auto number = std::get_if<double>(&val->value)) {
+                    tag = CellTag::Number;
+                    numbers.push_back(*number);
+                }
+                else if (auto boolean = std::get_if<bool>(&val->value)) {
+                    tag = *boolean ? CellTag::True : CellTag::False;
+                }
+                else if (auto text = std::get_if<std::string>(&val->value)) {
+                    tag = CellTag::String;
+                    writeVarint(strings, intern(*text));
+                }
+            }
+            else if (auto val = std::get_if<CellAddress>(&cellValue->value)) {
+                tag = CellTag::Reference;
+                writeSignedVarint(references, static_cast<int64_t>(val->row) - static_cast<int64_t>(row));
+                writeSignedVarint(references, static_cast<int64_t>(val->column) - static_cast<int64_t>(column));
+            }
+            else if (auto val = std::get_if<FormulaValue>(&cellValue->value)) {
+                tag = CellTag::Formula;
+                writeVarint(formulas, intern(TableParser::serializeSharedFormula(*val, address)));
+            }
+            else if (auto val = std::get_if<SheetAddress>(&cellValue->value)) {
+                tag = CellTag::SheetReference;
+                writeVarint(sheetReferences, intern(val->sheet));
+                writeSignedVarint(sheetReferences, static_cast<int64_t>(val->address.row) - static_cast<int64_t>(row));
+                writeSignedVarint(sheetReferences, static_cast<int64_t>(val->address.column) - static_cast<int64_t>(column));
+            }
+
+            // Tags may straddle a byte boundary
+            size_t bit = i * 3;
+            uint16_t packed = static_cast<uint16_t>(static_cast<uint8_t>(tag)) << (bit % 8);
+            tags[bit / 8] |= static_cast<char>(packed & 0xFF);
+            if (packed > 0xFF) {
+                tags[bit / 8 + 1] |= static_cast<char>(packed >> 8);
+            }
+        }
+
+        writeVarint(chunks, column);
+        writeVarint(chunks, cells.size());
+        chunks += rows;
+        chunks += tags;
+        writeNumbers(chunks, numbers);
+        chunks += strings;
+        chunks += references;
+        chunks += formulas;
+        chunks += sheetReferences;
+    }
+
+    std::string header = snapshotMagic;
+    writeVarint(header, dictionary.size());
+    for (const auto& entry : dictionary) {
+        writeVarint(header, entry.size());
+        header += entry;
+    }
+    writeVarint(header, columnIndices.size());
+
+    outputFile.write(header.data(), header.size());
+    outputFile.write(chunks.data(), chunks.size());
+    return static_cast<bool>(outputFile);
+}
+
+TableModel TableSnapshotParser::load(const std::string& filename) {
+    std::ifstream inputFile(filename, std::ios::binary);
+    if (!inputFile.is_open()) {
+        throw std::runtime_error("Error opening file for loading: " + filename);
+    }
+
+    std::ostringstream contents;
+    contents << inputFile.rdbuf();
+    const std::string data = contents.str();
+
+    if (data.compare(0, snapshotMagic.size(), snapshotMagic) != 0) {
+        throw std::runtime_error("Not a table snapshot: " + filename);
+    }
+
+    Reader reader(data);
+    reader.readBytes(snapshotMagic.size());
+
+    std::vector<std::string> dictionary(reader.readCount());
+    for (auto& entry : dictionary) {
+        entry = reader.readString();
+    }
+
+    // Each distinct formula body is parsed once, no matter how many cells share it
+    std::unordered_map<uint64_t, TableParser::SharedFormula> formulaBodies;
+
+    TableModel table;
+    uint64_t columnCount = reader.readCount();
+    for (uint64_t c = 0; c < columnCount; ++c) {
+        size_t column = reader.readVarint();
+        size_t cellCount = reader.readCount();
+
+        std::vector<size_t> rows(cellCount);
+        size_t row = 0;
+        for (auto& r : rows) {
+            row += reader.readVarint();
+            r = row;
+        }
+
+        const uint8_t* packedTags = reader.readBytes((cellCount * 3 + 7) / 8);
+        std::vector<CellTag> tags(cellCount);
+        size_t numberCount = 0;
+        for (size_t i = 0; i < cellCount; ++i) {
+            size_t bit = i * 3;
+            uint16_t packed = packedTags[bit / 8];
+            if (bit % 8 > 5) {
+                packed |= static_cast<uint16_t>(packedTags[bit / 8 + 1]) << 8;
+            }
+            tags[i] = static_cast<CellTag>((packed >> (bit % 8)) & 0x7);
+            if (tags[i] == CellTag::Number) {
+                ++numberCount;
+            }
+        }
+
+        std::vector<double> numbers = readNumbers(reader, numberCount);
+        size_t nextNumber = 0;
+
+        // Sections follow in tag order: strings, references, formulas, references to other sheets
+        std::vector<CellValue> values(cellCount);
+        for (size_t i = 0; i < cellCount; ++i) {
+            switch (tags[i]) {
+            case CellTag::Number: values[i] = CellValue{ LiteralValue{ numbers[nextNumber++] } }; break;
+            case CellTag::False: values[i] = CellValue{ LiteralValue{ false } }; break;
+            case CellTag::True: values[i] = CellValue{ LiteralValue{ true } }; break;
+            case CellTag::String: values[i] = CellValue{ LiteralValue{ dictionary.at(reader.readVarint()) } }; break;
+            default: break;
+            }
+        }
+        for (size_t i = 0; i < cellCount; ++i) {
+            if (tags[i] == CellTag::Reference) {
+                int64_t rowOffset = reader.readSignedVarint();
+                int64_t columnOffset = reader.readSignedVarint();
+                values[i] = CellValue{ CellAddress{ rows[i], column }.offsetBy(rowOffset, columnOffset) };
+            }
+        }
+        for (size_t i = 0; i < cellCount; ++i) {
+            if (tags[i] == CellTag::Formula) {
+                uint64_t index = reader.readVarint();
+                auto it = formulaBodies.find(index);
+                if (it == formulaBodies.end()) {
+                    auto body = TableParser::deserializeSharedFormula(dictionary.at(index));
+                    if (!body) {
+                        throw std::runtime_error("Corrupt formula in table snapshot: " + dictionary.at(index));
+                    }
+                    it = formulaBodies.emplace(index, *body).first;
+                }
+                values[i] = CellValue{ TableParser::instantiateSharedFormula(it->second, CellAddress{ rows[i], column }) };
+            }
+            else if (static_cast<uint8_t>(tags[i]) > static_cast<uint8_t>(CellTag::SheetReference)) {
+                throw std::runtime_error("Corrupt cell tag in table snapshot: " + filename);
+            }
+        }
+        for (size_t i = 0; i < cellCount; ++i) {
+            if (tags[i] == CellTag::SheetReference) {
+                const std::string& sheet = dictionary.at(reader.readVarint());
+                int64_t rowOffset = reader.readSignedVarint();
+                int64_t columnOffset = reader.readSignedVarint();
+                values[i] = CellValue{ SheetAddress{ sheet, CellAddress{ rows[i], column }.offsetBy(rowOffset, columnOffset) } };
+            }
+        }
+
+        for (size_t i = 0; i < cellCount; ++i) {
+            table.setCellValue(CellAddress{ rows[i], column }, std::move(values[i]));
+        }
+    }
+
+    return table;
+}
+
+bool TableSnapshotParser::isSnapshotFile(const std::string& filename) {
+    std::ifstream inputFile(filename, std::ios::binary);
+    std::string magic(snapshotMagic.size(), '\0');
+    inputFile.read(&magic[0], magic.size());
+    return inputFile && magic == snapshotMagic;
+}
+
+// - Numbers
+
+void TableSnapshotParser::writeNumbers(std::string& out, const std::vector<double>& numbers) {
+    // Each run starts with (length << 2 | kind)
+    size_t i = 0;
+    while (i < numbers.size()) {
+        size_t repeated = repeatedRunLength(numbers, i);
+        if (repeated >= minRepeatedRun) {
+            writeVarint(out, (static_cast<uint64_t>(repeated) << 2) | static_cast<uint8_t>(NumberRun::Repeated));
+            writeDouble(out, numbers[i]);
+            i += repeated;
+            continue;
+        }
+
+        bool integral = isIntegral(numbers[i]);
+        size_t end = i + 1;
+        while (end < numbers.size() && isIntegral(numbers[end]) == integral && repeatedRunLength(numbers, end) < minRepeatedRun) {
+            ++end;
+        }
+
+        if (integral) {
+            writeVarint(out, (static_cast<uint64_t>(end - i) << 2) | static_cast<uint8_t>(NumberRun::Integers));
+            int64_t previous = 0;
+            for (size_t j = i; j < end; ++j) {
+                int64_t value = static_cast<int64_t>(numbers[j]);
+                writeSignedVarint(out, value - previous);
+                previous = value;
+            }
+        }
+        else {
+            writeVarint(out, (static_cast<uint64_t>(end - i) << 2) | static_cast<uint8_t>(NumberRun::Raw));
+            for (size_t j = i; j < end; ++j) {
+                writeDouble(out, numbers[j]);
+            }
+        }
+        i = end;
+    }
+}
+
+std::vector<double> TableSnapshotParser::readNumbers(Reader& reader, size_t count) {
+    std::vector<double> numbers;
+    numbers.reserve(count);
+
+    while (numbers.size() < count) {
+        uint64_t header = reader.readVarint();
+        size_t length = header >> 2;
+        if (length == 0 || numbers.size() + length > count) {
+            throw std::runtime_error("Corrupt number run in table snapshot");
+        }
+
+        switch (static_cast<NumberRun>(header & 0x3)) {
+        case NumberRun::Repeated:
+            numbers.insert(numbers.end(), length, reader.readDouble());
+            break;
+        case NumberRun::Integers:
+        {
+            int64_t value = 0;
+            for (size_t j = 0; j < length; ++j) {
+                value += reader.readSignedVarint();
+                numbers.push_back(static_cast<double>(value));
+            }
+        }
+        break;
+        case NumberRun::Raw:
+            for (size_t j = 0; j < length; ++j) {
+                numbers.push_back(reader.readDouble());
+            }
+            break;
+        default:
+            throw std::runtime_error("Corrupt number run in table snapshot");
+        }
+    }
+    return numbers;
+}
+
+// - Encoding
+
+void TableSnapshotParser::writeVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+void TableSnapshotParser::writeSignedVarint(std::string& out, int64_t value) {
+    // Zigzag keeps small negative offsets small
+    writeVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void TableSnapshotParser::writeDouble(std::string& out, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 8; ++i) {
+        out += static_cast<char>((bits >> (8 * i)) & 0xFF);
+    }
+}
+
+TableSnapshotParser::Reader::Reader(const std::string& data) : data(data), position(0) {}
+
+uint64_t TableSnapshotParser::Reader::readVarint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (position >= data.size()) {
+            throw std::runtime_error("Unexpected end of table snapshot");
+        }
+        uint8_t byte = static_cast<uint8_t>(data[position++]);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Corrupt varint in table snapshot");
+}
+
+// Every counted entry takes at least one byte, a larger count can only come from a corrupt file
+uint64_t TableSnapshotParser::Reader::readCount() {
+    uint64_t count = readVarint();
+    if (count > data.size() - position) {
+        throw std::runtime_error("Corrupt count in table snapshot");
+    }
+    return count;
+}
+
+int64_t TableSnapshotParser::Reader::readSignedVarint() {
+    uint64_t value = readVarint();
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+double TableSnapshotParser::Reader::readDouble() {
+    const uint8_t* bytes = readBytes(8);
+    uint64_t bits = 0;
+    for (int i = 0; i < 8; ++i) {
+        bits |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+    }
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+std::string TableSnapshotParser::Reader::readString() {
+    size_t length = readVarint();
+    const uint8_t* bytes = readBytes(length);
+    return std::string(reinterpret_cast<const char*>(bytes), length);
+}
+
+const uint8_t* TableSnapshotParser::Reader::readBytes(size_t count) {
+    if (count > data.size() - position) {
+        throw std::runtime_error("Unexpected end of table snapshot");
+    }
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data() + position);
+    position += count;
+    return bytes;
+}
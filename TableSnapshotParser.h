@@ -0,0 +1,63 @@
+#pragma once
+
+#include "TableModel.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Compressed binary snapshot of a table, stored as one chunk per column:
+//  - row indices are delta encoded varints
+//  - cell type tags are bit-packed, 3 bits per cell
+//  - numbers are split into runs of repeated values (RLE), integer runs (zigzag deltas) and raw doubles
+//  - strings and formula bodies go through a shared dictionary, formulas in their relative (shared) form
+//  - references are stored as zigzag offsets from their cell, references to other sheets also with the sheet name
+class TableSnapshotParser {
+public:
+    static const std::string fileExtension;
+
+    static bool save(const TableModel& table, const std::string& filename);
+    static TableModel load(const std::string& filename);
+
+    static bool isSnapshotFile(const std::string& filename);
+
+private:
+    enum class CellTag : uint8_t {
+        Number = 0,
+        False = 1,
+        True = 2,
+        String = 3,
+        Reference = 4,
+        Formula = 5,
+        SheetReference = 6
+    };
+
+    enum class NumberRun : uint8_t {
+        Repeated = 0,
+        Integers = 1,
+        Raw = 2
+    };
+
+    class Reader {
+    public:
+        explicit Reader(const std::string& data);
+
+        uint64_t readVarint();
+        // Number of entries that follow, checked against the bytes left before anything is allocated
+        uint64_t readCount();
+        int64_t readSignedVarint();
+        double readDouble();
+        std::string readString();
+        const uint8_t* readBytes(size_t count);
+
+    private:
+        const std::string& data;
+        size_t position;
+    };
+
+    static void writeVarint(std::string& out, uint64_t value);
+    static void writeSignedVarint(std::string& out, int64_t value);
+    static void writeDouble(std::string& out, double value);
+
+    static void writeNumbers(std::string& out, const std::vector<double>& numbers);
+    static std::vector<double> readNumbers(Reader& reader, size_t count);
+};
@@ -3,135 +3,278 @@
 #include "TableConfiguration.h"
 #include "DisplayableTableModel.h"
 #include "CellAddress.h"
+#include "Tracer.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cerrno>
+#include <cstdio>
 
 #ifdef _WIN32
 #include <windows.h>
+#include <io.h>
 #else
-#include <cstdlib>
+#include <unistd.h>
+#include <sys/ioctl.h>
 #endif
 
-TableView::TableView(const TableViewModel& viewModel)
-    : viewModel(viewModel) {
+// Cursor home, clear screen and scrollback
+static const char* const clearScreenSequence = "\x1b[H\x1b[2J\x1b[3J";
+
+// Cells still being recalculated are dimmed on a terminal, which takes no room in the layout
+static const char* const staleStyleStart = "\x1b[2m";
+static const char* const staleStyleEnd = "\x1b[22m";
+
+TableView::TableView(TableViewModel& viewModel)
+    : viewModel(viewModel), dimStaleCells(isTerminal()) {
+    viewModel.addObserver(*this);
+
+#ifdef _WIN32
+    // Let the Windows console interpret the ANSI sequences used for clearing
+    HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD mode = 0;
+    if (GetConsoleMode(console, &mode)) {
+        SetConsoleMode(console, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+    }
+#endif
 }
 
 void TableView::redraw() const {
+    TraceSpan span("render", "redraw");
     const auto& config = viewModel.getConfiguration();
+    Layout layout = calculateLayout();
 
-    if (config.clearConsoleAfterCommand) {
-        clearConsole();
+    frame.clear();
+
+    if (config.clearConsoleAfterCommand && canRedrawInPlace(layout)) {
+        drawChangedCells(layout);
+    }
+    else {
+        if (config.clearConsoleAfterCommand) {
+            clearConsole();
+        }
+        drawTable(layout);
+
+        // Without clearing, every frame is printed below the previous one and can't be updated in place
+        renderedFrame.valid = config.clearConsoleAfterCommand;
     }
 
-    drawTable();
+    writeFrame();
+}
+
+TableView::~TableView() {
+    viewModel.removeObserver(*this);
+}
+
+void TableView::tableChanged(const ChangeSet& changes) {
+    changedCells.insert(changes.cells.begin(), changes.cells.end());
+}
+
+void TableView::invalidate() {
+    renderedFrame.valid = false;
 }
 
 void TableView::clearConsole() const {
-#ifdef _WIN32
-    system("cls");
-#else
-    system("clear");
-#endif
+    frame += clearScreenSequence;
 }
 
-void TableView::drawTable() const {
-    std::vector<int> columnWidths = calculateColumnWidths();
+void TableView::drawTable(const Layout& layout) const {
+    renderedFrame.layout = layout;
+    renderedFrame.cells.clear();
+    renderedFrame.staleCells.clear();
+    changedCells.clear();
+
+    // Every line is as wide as the header, which leaves room for the row label
+    size_t lineLength = layout.labelWidth + 5;
+    for (int width : layout.columnWidths) {
+        lineLength += width + 1;
+    }
+    frame.reserve(frame.size() + lineLength * (2 * layout.visibleRows + 3));
 
-    drawHeader();
-    drawSeparatorLine(columnWidths);
+    drawHeader(layout);
+    drawSeparatorLine(layout);
 
-    int visibleRows = getVisibleRows();
-    for (int row = 0; row < visibleRows; ++row) {
-        drawRow(row, columnWidths);
-        if (row < visibleRows - 1) {
-            drawSeparatorLine(columnWidths);
+    for (int row = 0; row < layout.visibleRows; ++row) {
+        drawRow(row, layout);
+        if (row < layout.visibleRows - 1) {
+            drawSeparatorLine(layout);
         }
     }
 
-    drawSeparatorLine(columnWidths);
+    drawSeparatorLine(layout);
 }
 
-void TableView::drawHeader() const {
-    std::vector<int> columnWidths = calculateColumnWidths();
-    int visibleCols = getVisibleCols();
-
+void TableView::drawHeader(const Layout& layout) const {
     // Draw top border
-    std::cout << "|";
-    for (int i = 0; i < 4; ++i) {
-        std::cout << "-";
-    }
-    std::cout << "|";
+    drawSeparatorLine(layout);
 
-    for (int col = 0; col < visibleCols; ++col) {
-        for (int i = 0; i < columnWidths[col]; ++i) {
-            std::cout << "-";
-        }
-        std::cout << "|";
+    // Draw header row with column numbers
+    frame += '|';
+    frame.append(layout.labelWidth + 2, ' ');
+    frame += '|';
+    for (size_t col = 0; col < layout.columnWidths.size(); ++col) {
+        appendCellContent(std::to_string(layout.origin.column + col + 1), layout.columnWidths[col], Alignment::Center);
+        frame += '|';
     }
-    std::cout << std::endl;
+    frame += '\n';
+}
 
-    // Draw header row with column numbers
-    std::cout << "|    |";
-    for (int col = 0; col < visibleCols; ++col) {
-        std::string colLabel = std::to_string(col + 1);
-        std::string formatted = formatCellContent(colLabel, columnWidths[col], Alignment::Center);
-        std::cout << formatted << "|";
+void TableView::drawSeparatorLine(const Layout& layout) const {
+    frame += '|';
+    frame.append(layout.labelWidth + 2, '-');
+    frame += '|';
+    for (int width : layout.columnWidths) {
+        frame.append(width, '-');
+        frame += '|';
     }
-    std::cout << std::endl;
+    frame += '\n';
 }
 
-void TableView::drawSeparatorLine(const std::vector<int>& columnWidths) const {
-    int visibleCols = getVisibleCols();
+void TableView::drawRow(int rowIndex, const Layout& layout) const {
+    const auto& config = viewModel.getConfiguration();
+
+    // Draw row label (A, B, C, etc.), left aligned
+    std::string rowLabel = getRowLabel(layout.origin.row + rowIndex);
+    frame += "| ";
+    frame += rowLabel;
+    frame.append(layout.labelWidth - rowLabel.length(), ' ');
+    frame += " |";
 
-    std::cout << "|";
-    for (int i = 0; i < 4; ++i) {
-        std::cout << "-";
+    // Draw cells in the row
+    for (size_t col = 0; col < layout.columnWidths.size(); ++col) {
+        const std::string& content = getCellDisplayValue(layout.origin, rowIndex, static_cast<int>(col));
+        bool stale = viewModel.isStale(CellAddress{ layout.origin.row + rowIndex, layout.origin.column + col });
+        appendCell(content, stale, layout.columnWidths[col], config.initialAlignment);
+        frame += '|';
+        renderedFrame.cells.push_back(content);
+        renderedFrame.staleCells.push_back(stale);
     }
-    std::cout << "|";
+    frame += '\n';
+}
+
+// Repaints only the cells reported changed since the last frame, whose layout is still on screen
+void TableView::drawChangedCells(const Layout& layout) const {
+    size_t visibleCells = static_cast<size_t>(layout.visibleRows) * layout.columnWidths.size();
 
-    for (int col = 0; col < visibleCols; ++col) {
-        for (int i = 0; i < columnWidths[col]; ++i) {
-            std::cout << "-";
+    // Walk whichever is smaller, the changed cells or the viewport
+    if (changedCells.size() < visibleCells) {
+        for (const auto& address : changedCells) {
+            if (address.row >= layout.origin.row && address.row < layout.origin.row + layout.visibleRows &&
+                address.column >= layout.origin.column && address.column < layout.origin.column + layout.columnWidths.size()) {
+                drawCellIfChanged(layout, static_cast<int>(address.row - layout.origin.row), static_cast<int>(address.column - layout.origin.column));
+            }
+        }
+    }
+    else {
+        for (int row = 0; row < layout.visibleRows; ++row) {
+            for (size_t col = 0; col < layout.columnWidths.size(); ++col) {
+                drawCellIfChanged(layout, row, static_cast<int>(col));
+            }
         }
-        std::cout << "|";
     }
-    std::cout << std::endl;
+    changedCells.clear();
+
+    // Back below the table, clearing the previous prompt and input
+    moveCursor(2 * layout.visibleRows + 4, 1);
+    frame += "\x1b[J";
 }
 
-void TableView::drawRow(int rowIndex, const std::vector<int>& columnWidths) const {
-    int visibleCols = getVisibleCols();
+void TableView::drawCellIfChanged(const Layout& layout, int row, int col) const {
     const auto& config = viewModel.getConfiguration();
+    size_t cell = static_cast<size_t>(row) * layout.columnWidths.size() + col;
 
-    // Draw row label (A, B, C, etc.)
-    std::string rowLabel = getRowLabel(rowIndex);
-    std::cout << "| " << std::setw(2) << std::left << rowLabel << " |";
+    const std::string& content = getCellDisplayValue(layout.origin, row, col);
+    bool stale = viewModel.isStale(CellAddress{ layout.origin.row + row, layout.origin.column + col });
+    if (content == renderedFrame.cells[cell] && stale == renderedFrame.staleCells[cell]) {
+        return;
+    }
 
-    // Draw cells in the row
-    for (int col = 0; col < visibleCols; ++col) {
-        std::string cellContent = getCellDisplayValue(rowIndex, col);
-        std::string formatted = formatCellContent(cellContent, columnWidths[col], config.initialAlignment);
-        std::cout << formatted << "|";
+    // Console lines and columns are 1-based: two header lines and a separator come before the first row,
+    // and the first cell starts after the "| A  |" row label
+    int consoleColumn = layout.labelWidth + 5;
+    for (int previous = 0; previous < col; ++previous) {
+        consoleColumn += layout.columnWidths[previous] + 1;
+    }
+
+    moveCursor(4 + 2 * row, consoleColumn);
+    appendCell(content, stale, layout.columnWidths[col], config.initialAlignment);
+    renderedFrame.cells[cell] = content;
+    renderedFrame.staleCells[cell] = stale;
+}
+
+bool TableView::canRedrawInPlace(const Layout& layout) const {
+    if (!renderedFrame.valid || renderedFrame.layout != layout) {
+        return false;
     }
-    std::cout << std::endl;
+
+    // The table, the prompt and the echoed input must fit on screen, or cursor positions would be off after scrolling
+    int frameLines = 2 * layout.visibleRows + 3;
+    return frameLines + 2 < getTerminalHeight();
+}
+
+void TableView::moveCursor(int line, int column) const {
+    frame += "\x1b[";
+    frame += std::to_string(line);
+    frame += ';';
+    frame += std::to_string(column);
+    frame += 'H';
 }
 
-std::vector<int> TableView::calculateColumnWidths() const {
+void TableView::writeFrame() const {
+    // Anything still buffered in std::cout (like the last prompt) has to come first
+    std::cout.flush();
+
+#ifdef _WIN32
+    std::fwrite(frame.data(), 1, frame.size(), stdout);
+    std::fflush(stdout);
+#else
+    const char* data = frame.data();
+    size_t remaining = frame.size();
+    while (remaining > 0) {
+        ssize_t written = ::write(STDOUT_FILENO, data, remaining);
+        if (written < 0 && errno == EINTR) {
+            // A signal such as SIGWINCH arrived before anything was written
+            continue;
+        }
+        if (written <= 0) {
+            break;
+        }
+        data += written;
+        remaining -= static_cast<size_t>(written);
+    }
+#endif
+}
+
+TableView::Layout TableView::calculateLayout() const {
+    Viewport viewport = viewModel.getViewport();
+
+    Layout layout;
+    layout.origin = viewport.origin;
+    layout.visibleRows = static_cast<int>(viewport.rows);
+    // Labels only get longer further down, so the last visible row has the widest
+    layout.labelWidth = std::max<int>(2, static_cast<int>(getRowLabel(viewport.origin.row + viewport.rows - 1).length()));
+    layout.columnWidths = calculateColumnWidths(viewport);
+    return layout;
+}
+
+// Widths come from the longest value of each column, which the displayable model keeps up to date
+std::vector<int> TableView::calculateColumnWidths(const Viewport& viewport) const {
     const auto& config = viewModel.getConfiguration();
-    int visibleCols = getVisibleCols();
+    const auto& displayModel = viewModel.getDisplayableTableModel();
+    int visibleCols = static_cast<int>(viewport.columns);
     std::vector<int> widths(visibleCols);
 
     if (config.autoFit) {
         // Calculate width based on content
         for (int col = 0; col < visibleCols; ++col) {
-            // Minimum width for column number
-            int maxWidth = 3;
+            size_t column = viewport.origin.column + col;
 
-            int visibleRows = getVisibleRows();
-            for (int row = 0; row < visibleRows; ++row) {
-                std::string content = getCellDisplayValue(row, col);
-                maxWidth = max(maxWidth, content.length());
-            }
+            // Minimum width for column number
+            size_t maxWidth = std::max<size_t>(3, std::to_string(column + 1).length());
+            maxWidth = std::max(maxWidth, displayModel.getMaxValueLength(column));
 
             // Add padding
-            widths[col] = maxWidth + 2;
+            widths[col] = static_cast<int>(maxWidth) + 2;
         }
     }
     else {
@@ -145,93 +288,97 @@ std::vector<int> TableView::calculateColumnWidths() const {
     return widths;
 }
 
-std::string TableView::formatCellContent(const std::string& content, int width, Alignment alignment) const {
-    std::string truncated = content;
+void TableView::appendCellContent(const std::string& content, int width, Alignment alignment) const {
     // Account for padding
     int availableWidth = width - 2;
+    int contentLength = std::min(static_cast<int>(content.length()), availableWidth);
+    int totalPadding = availableWidth - contentLength;
 
-    if (static_cast<int>(truncated.length()) > availableWidth) {
-        truncated = truncated.substr(0, availableWidth);
-    }
-
-    std::ostringstream oss;
-    // Left padding
-    oss << " ";
-
+    int leftPadding = 0;
     switch (alignment) {
     case Alignment::Left:
-        oss << std::left << std::setw(availableWidth) << truncated;
+        leftPadding = 0;
         break;
     case Alignment::Center:
-    {
-        int totalPadding = availableWidth - static_cast<int>(truncated.length());
-        int leftPadding = totalPadding / 2;
-        int rightPadding = totalPadding - leftPadding;
-
-        for (int i = 0; i < leftPadding; ++i) oss << " ";
-        oss << truncated;
-        for (int i = 0; i < rightPadding; ++i) oss << " ";
-    }
-    break;
+        leftPadding = totalPadding / 2;
+        break;
     case Alignment::Right:
-        oss << std::right << std::setw(availableWidth) << truncated;
+        leftPadding = totalPadding;
         break;
     }
 
+    // Left padding
+    frame.append(1 + leftPadding, ' ');
+    frame.append(content, 0, contentLength);
     // Right padding
-    oss << " ";
-    return oss.str();
+    frame.append(totalPadding - leftPadding + 1, ' ');
 }
 
-std::string TableView::getRowLabel(int rowIndex) const {
+void TableView::appendCell(const std::string& content, bool stale, int width, Alignment alignment) const {
+    if (stale && dimStaleCells) {
+        frame += staleStyleStart;
+    }
+    appendCellContent(content, width, alignment);
+    if (stale && dimStaleCells) {
+        frame += staleStyleEnd;
+    }
+}
+
+std::string TableView::getRowLabel(size_t rowIndex) const {
     // Convert 0-based index to Excel-style letters (A, B, C, ..., Z, AA, AB, ...)
     std::string label;
-    int index = rowIndex;
+    size_t index = rowIndex + 1;
 
     do {
+        --index;
         label = char('A' + (index % 26)) + label;
-        index = index / 26 - 1;
-    } while (index >= 0);
+        index /= 26;
+    } while (index > 0);
 
     return label;
 }
 
-std::string TableView::getCellDisplayValue(int row, int col) const {
+// Row and column are relative to the viewport origin
+const std::string& TableView::getCellDisplayValue(const CellAddress& origin, int row, int col) const {
+    static const std::string emptyValue;
+
     const auto& displayModel = viewModel.getDisplayableTableModel();
-    CellAddress address{ row, col };
+    CellAddress address{ origin.row + row, origin.column + col };
 
     const std::string* value = displayModel.getDisplayValue(address);
-    return value ? *value : "";
+    return value ? *value : emptyValue;
 }
 
-int TableView::getVisibleRows() const {
-    const auto& config = viewModel.getConfiguration();
-    int initialRows = config.initialTableRows;
-    int maxRows = config.maxTableRows;
-    int actualRows = viewModel.getDisplayableTableModel().getRowCount();
-    if (actualRows < initialRows) {
-        return initialRows;
-    }
-    else if (actualRows > maxRows) {
-        return maxRows;
-    }
-    else {
-        return actualRows;
-    }
+// Piped or redirected output gets no styling sequences
+bool TableView::isTerminal() {
+#ifdef _WIN32
+    return _isatty(_fileno(stdout)) != 0;
+#else
+    return isatty(STDOUT_FILENO) != 0;
+#endif
 }
 
-int TableView::getVisibleCols() const {
-    const auto& config = viewModel.getConfiguration();
-    int initialCols = config.initialTableRows;
-    int maxCols = config.maxTableRows;
-    int actualCols = viewModel.getDisplayableTableModel().getColumnCount();
-    if (actualCols < initialCols) {
-        return initialCols;
-    }
-    else if (actualCols > maxCols) {
-        return maxCols;
+// Rows of the console window, 0 when output is not a terminal
+int TableView::getTerminalHeight() {
+#ifdef _WIN32
+    CONSOLE_SCREEN_BUFFER_INFO info;
+    if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info)) {
+        return info.srWindow.Bottom - info.srWindow.Top + 1;
     }
-    else {
-        return actualCols;
+    return 0;
+#else
+    winsize size{};
+    if (isatty(STDOUT_FILENO) && ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0) {
+        return size.ws_row;
     }
-}
\ No newline at end of file
+    return 0;
+#endif
+}
+
+bool TableView::Layout::operator==(const Layout& other) const {
+    return origin == other.origin && visibleRows == other.visibleRows && labelWidth == other.labelWidth && columnWidths == other.columnWidths;
+}
+
+bool TableView::Layout::operator!=(const Layout& other) const {
+    return !(*this == other);
+}
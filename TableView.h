@@ -1,33 +1,75 @@
 #pragma once
 
-#include <iostream>
 #include <string>
 #include <vector>
-#include <iomanip>
-#include <sstream>
+#include <unordered_set>
 #include "TableViewModel.h"
+#include "TableObserver.h"
 
-class TableView {
+class TableView : public TableObserver {
 public:
-    explicit TableView(const TableViewModel& viewModel);
+    explicit TableView(TableViewModel& viewModel);
+    ~TableView() override;
+
+    TableView(const TableView&) = delete;
+    TableView& operator=(const TableView&) = delete;
 
     void redraw() const;
 
+    // Cells changed since the last redraw are the only ones repainted in place
+    void tableChanged(const ChangeSet& changes) override;
+
+    // Forces the next redraw to repaint everything, e.g. after other output scrolled the console
+    void invalidate();
+
 private:
-    const TableViewModel& viewModel;
+    // Where everything is on screen; while it stays the same, cells can be updated in place
+    struct Layout {
+        CellAddress origin{ 0, 0 };
+        int visibleRows = 0;
+        int labelWidth = 0;
+        std::vector<int> columnWidths;
+
+        bool operator==(const Layout& other) const;
+        bool operator!=(const Layout& other) const;
+    };
+
+    // What is currently on screen, so a redraw can repaint only the cells that changed
+    struct RenderedFrame {
+        bool valid = false;
+        Layout layout;
+        std::vector<std::string> cells; // display value of each visible cell, row by row
+        std::vector<bool> staleCells;
+    };
+
+    TableViewModel& viewModel;
+    const bool dimStaleCells;
+    mutable RenderedFrame renderedFrame;
+    mutable std::unordered_set<CellAddress> changedCells;
+
+    // The whole frame is composed here and written to the console in one call.
+    // Keeping it between redraws keeps its capacity, so steady-state frames don't allocate.
+    mutable std::string frame;
 
     // Helper methods for drawing
     void clearConsole() const;
-    void drawTable() const;
-    void drawHeader() const;
-    void drawSeparatorLine(const std::vector<int>& columnWidths) const;
-    void drawRow(int rowIndex, const std::vector<int>& columnWidths) const;
+    void drawTable(const Layout& layout) const;
+    void drawChangedCells(const Layout& layout) const;
+    void drawCellIfChanged(const Layout& layout, int row, int col) const;
+    bool canRedrawInPlace(const Layout& layout) const;
+    void moveCursor(int line, int column) const;
+    void drawHeader(const Layout& layout) const;
+    void drawSeparatorLine(const Layout& layout) const;
+    void drawRow(int rowIndex, const Layout& layout) const;
+    void writeFrame() const;
 
     // Utility methods
-    std::vector<int> calculateColumnWidths() const;
-    std::string formatCellContent(const std::string& content, int width, Alignment alignment) const;
-    std::string getRowLabel(int colIndex) const;
-    std::string getCellDisplayValue(int row, int col) const;
-    int getVisibleRows() const;
-    int getVisibleCols() const;
-};
\ No newline at end of file
+    Layout calculateLayout() const;
+    std::vector<int> calculateColumnWidths(const Viewport& viewport) const;
+    void appendCellContent(const std::string& content, int width, Alignment alignment) const;
+    void appendCell(const std::string& content, bool stale, int width, Alignment alignment) const;
+    std::string getRowLabel(size_t rowIndex) const;
+    const std::string& getCellDisplayValue(const CellAddress& origin, int row, int col) const;
+    static bool isTerminal();
+    static int getTerminalHeight();
+};
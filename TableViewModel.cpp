@@ -1,31 +1,253 @@
 #include "TableViewModel.h"
+#include "TableParser.h"
+#include "Tracer.h"
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
+#include <utility>
 
-TableViewModel::TableViewModel(TableConfiguration config, TableModel tableModel)
-    : configuration(std::move(config)), tableModel(std::move(tableModel)) {
-    updateAllDisplayableCells();
+TableViewModel::TableViewModel(TableConfiguration config, TableModel tableModel, const SheetResolver* sheets, std::shared_mutex* tableMutex)
+    : configuration(std::move(config)), tableModel(std::move(tableModel)), sheets(sheets),
+    recalculationWorker(this->tableModel, configuration.recalcThreads, configuration.evaluationCacheSize, std::chrono::milliseconds(configuration.recalcTimeBudgetMs),
+        sheets, tableMutex) {
+    rebuildDependencies();
+
+    // Only the viewport is evaluated before the first frame, the rest of the table once it is needed
+    for (const auto& [address, value] : this->tableModel.getAllCells()) {
+        pendingCells.insert(address);
+        pendingExtent = CellAddress{ std::max(pendingExtent.row, address.row), std::max(pendingExtent.column, address.column) };
+    }
+    evaluateViewport();
+
+    // Observers start out from the whole table
+    changes = ChangeSet();
 }
 
-// We need to make sure we update both the TableModel and all of the DisplayableTableModel on each event handled
+// We need to make sure we update both the TableModel and the affected cells of the DisplayableTableModel on each event handled
 void TableViewModel::handle(const Event& event) {
+    TraceSpan span("table", "handle");
+    apply(event);
+    if (!inTransaction && needsRecalculation()) {
+        flush();
+    }
+    notifyObservers();
+}
+
+void TableViewModel::apply(const Event& event) {
     if (auto e = std::get_if<InsertEvent>(&event)) {
-        tableModel.setCellValue(e->target, CellValue{ e->value } );
-        updateAllDisplayableCells();
+        setCell(e->target, CellValue{ e->value });
     }
     else if (auto e = std::get_if<DeleteEvent>(&event)) {
-        tableModel.removeCellValue(e->target);
-        displayableTableModel.removeDisplayValue(e->target);
-        updateAllDisplayableCells();
+        removeCell(e->target);
     }
     else if (auto e = std::get_if<ReferenceEvent>(&event)) {
-        tableModel.setCellValue(e->target, CellValue{ e->source });
-        updateAllDisplayableCells();
+        setCell(e->target, e->sheet ? CellValue{ SheetAddress{ *e->sheet, e->source } } : CellValue{ e->source });
     }
     else if (auto e = std::get_if<FormulaEvent>(&event)) {
-        tableModel.setCellValue(e->target, CellValue{ FormulaValue{e->formula, e->params} });
-        updateAllDisplayableCells();
+        setCell(e->target, CellValue{ FormulaValue{e->formula, e->params} });
+    }
+    else if (auto e = std::get_if<FillEvent>(&event)) {
+        applyFill(*e);
+    }
+    else if (auto e = std::get_if<FillDownEvent>(&event)) {
+        applyFillDown(*e);
+    }
+    else if (auto e = std::get_if<PasteEvent>(&event)) {
+        applyPaste(*e);
+    }
+    else if (auto e = std::get_if<ImportEvent>(&event)) {
+        applyImport(*e);
+    }
+    else if (std::holds_alternative<BeginEvent>(event)) {
+        beginTransaction();
+    }
+    else if (std::holds_alternative<CommitEvent>(event)) {
+        commitTransaction();
+    }
+    else if (std::holds_alternative<RollbackEvent>(event)) {
+        rollbackTransaction();
+    }
+    else if (std::holds_alternative<UndoEvent>(event)) {
+        if (!undo()) {
+            throw std::runtime_error("Nothing to undo");
+        }
+    }
+    else if (std::holds_alternative<RedoEvent>(event)) {
+        if (!redo()) {
+            throw std::runtime_error("Nothing to redo");
+        }
+    }
+    else if (auto e = std::get_if<GotoEvent>(&event)) {
+        setViewportOrigin(e->target);
+        evaluateViewport();
+    }
+    else if (auto e = std::get_if<ScrollEvent>(&event)) {
+        applyScroll(*e);
+        evaluateViewport();
+    }
+    else if (std::holds_alternative<CalculateEvent>(event)) {
+        recalculate();
+    }
+    else if (auto e = std::get_if<ExportEvent>(&event)) {
+        // Exported values have to reflect everything applied so far, also in manual calculation mode
+        recalculate();
+        waitForRecalculation();
+        evaluatePendingCells();
+        if (!TableParser::exportCsv(tableModel, displayableTableModel, e->fileName, e->evaluated)) {
+            throw std::runtime_error("Could not export table to '" + e->fileName + "'");
+        }
     }
 }
 
+void TableViewModel::recalculate() {
+    TraceSpan span("recalc", "recalculate");
+    markAffectedCellsStale();
+
+    if (!staleCells.empty() && !staleCellsScheduled) {
+        // The new job supersedes the running one, so it also takes over the cells that one had left.
+        // Visible cells go first.
+        std::vector<CellAddress> job(staleCells.begin(), staleCells.end());
+        Viewport viewport = getViewport();
+        std::stable_partition(job.begin(), job.end(), [&viewport](const CellAddress& address) {
+            return viewport.contains(address);
+        });
+        recalculationWorker.start(std::move(job));
+        staleCellsScheduled = true;
+    }
+
+    // The table may have grown into a larger viewport
+    evaluateViewport();
+
+    if (!inTransaction) {
+        finishEdit();
+    }
+}
+
+void TableViewModel::recalculateAll() {
+    for (const auto& [address, value] : tableModel.getAllCells()) {
+        dirtyCells.insert(address);
+    }
+    recalculate();
+    waitForRecalculation();
+}
+
+bool TableViewModel::needsRecalculation() const {
+    return !dirtyCells.empty();
+}
+
+void TableViewModel::flush() {
+    if (configuration.calculationMode == CalculationMode::Automatic) {
+        recalculate();
+        return;
+    }
+
+    markAffectedCellsStale();
+    evaluateViewport();
+
+    if (!inTransaction) {
+        finishEdit();
+    }
+}
+
+bool TableViewModel::waitForRecalculation(std::chrono::milliseconds timeout) {
+    TraceSpan span("recalc", "wait");
+    recalculationWorker.wait(timeout);
+    collectRecalculationResults();
+    notifyObservers();
+    return staleCells.empty();
+}
+
+void TableViewModel::waitForRecalculation() {
+    TraceSpan span("recalc", "wait");
+    recalculationWorker.wait();
+    collectRecalculationResults();
+    notifyObservers();
+}
+
+bool TableViewModel::isRecalculating() const {
+    return !staleCells.empty();
+}
+
+bool TableViewModel::isStale(const CellAddress& address) const {
+    return !staleCells.empty() && staleCells.count(address) > 0;
+}
+
+Viewport TableViewModel::getViewport() const {
+    // Only the part of the table at or after the origin counts towards growing the viewport
+    auto visibleSize = [](size_t count, size_t origin, int initialSize, int maxSize) {
+        size_t remaining = count > origin ? count - origin : 0;
+        return std::clamp(remaining, static_cast<size_t>(initialSize), static_cast<size_t>(std::max(initialSize, maxSize)));
+    };
+
+    size_t rowCount = displayableTableModel.getRowCount();
+    size_t columnCount = displayableTableModel.getColumnCount();
+    if (!pendingCells.empty()) {
+        rowCount = std::max(rowCount, pendingExtent.row + 1);
+        columnCount = std::max(columnCount, pendingExtent.column + 1);
+    }
+
+    return Viewport{
+        viewportOrigin,
+        visibleSize(rowCount, viewportOrigin.row, configuration.initialTableRows, configuration.maxTableRows),
+        visibleSize(columnCount, viewportOrigin.column, configuration.initialTableCols, configuration.maxTableCols)
+    };
+}
+
+bool Viewport::contains(const CellAddress& address) const {
+    return address.row >= origin.row && address.row < origin.row + rows &&
+        address.column >= origin.column && address.column < origin.column + columns;
+}
+
+std::vector<CellAddress> TableViewModel::collectSheetDependents(const std::string& sheet, const std::vector<CellAddress>& cells) const {
+    return dependencyGraph.collectSheetDependents(sheet, cells);
+}
+
+std::vector<CellAddress> TableViewModel::collectSheetDependents(const std::string& sheet) const {
+    return dependencyGraph.collectSheetDependents(sheet);
+}
+
+void TableViewModel::invalidate(const std::vector<CellAddress>& cells) {
+    if (cells.empty()) {
+        return;
+    }
+
+    cancelRecalculation();
+    dirtyCells.insert(cells.begin(), cells.end());
+    if (!inTransaction) {
+        flush();
+    }
+    notifyObservers();
+}
+
+std::vector<CellAddress> TableViewModel::takeInvalidatedCells() {
+    std::vector<CellAddress> taken;
+    taken.swap(invalidatedCells);
+    return taken;
+}
+
+// Values evaluated so far still match the table, anything after a change would not
+void TableViewModel::cancelRecalculation() {
+    if (!staleCells.empty()) {
+        collectRecalculationResults();
+        recalculationWorker.cancel();
+        staleCellsScheduled = false;
+    }
+}
+
+void TableViewModel::addObserver(TableObserver& observer) {
+    observers.push_back(&observer);
+}
+
+void TableViewModel::removeObserver(TableObserver& observer) {
+    observers.erase(std::remove(observers.begin(), observers.end(), &observer), observers.end());
+}
+
+EvaluationProfile TableViewModel::getEvaluationProfile() {
+    EvaluationProfile profile = recalculationWorker.getProfile();
+    profile.merge(evaluationProfile);
+    return profile;
+}
+
 const TableConfiguration& TableViewModel::getConfiguration() const {
     return configuration;
 }
@@ -38,19 +260,346 @@ const DisplayableTableModel& TableViewModel::getDisplayableTableModel() const {
     return displayableTableModel;
 }
 
-void TableViewModel::updateDisplayableCell(const CellAddress& address) {
+// - Transactions
+
+void TableViewModel::beginTransaction() {
+    if (inTransaction) {
+        throw std::runtime_error("A transaction is already in progress");
+    }
+    // Changes applied before the transaction are their own edit
+    if (needsRecalculation()) {
+        flush();
+    }
+    inTransaction = true;
+}
+
+void TableViewModel::commitTransaction() {
+    if (!inTransaction) {
+        throw std::runtime_error("No transaction in progress");
+    }
+    inTransaction = false;
+    flush();
+}
+
+void TableViewModel::rollbackTransaction() {
+    if (!inTransaction) {
+        throw std::runtime_error("No transaction in progress");
+    }
+    inTransaction = false;
+
+    for (const auto& [address, before] : pendingEdit) {
+        writeCell(address, before);
+    }
+    pendingEdit.clear();
+    flush();
+}
+
+bool TableViewModel::isInTransaction() const {
+    return inTransaction;
+}
+
+// - Undo / Redo
+
+bool TableViewModel::undo() {
+    if (inTransaction) {
+        throw std::runtime_error("Cannot undo inside a transaction");
+    }
+    if (needsRecalculation()) {
+        flush();
+    }
+
+    const Edit* edit = history.undo();
+    if (!edit) {
+        return false;
+    }
+
+    for (const auto& delta : *edit) {
+        writeCell(delta.address, delta.before);
+    }
+    flush();
+    return true;
+}
+
+bool TableViewModel::redo() {
+    if (inTransaction) {
+        throw std::runtime_error("Cannot redo inside a transaction");
+    }
+    if (needsRecalculation()) {
+        flush();
+    }
+
+    const Edit* edit = history.redo();
+    if (!edit) {
+        return false;
+    }
+
+    for (const auto& delta : *edit) {
+        writeCell(delta.address, delta.after);
+    }
+    flush();
+    return true;
+}
+
+void TableViewModel::recordChange(const CellAddress& address) {
+    if (pendingEdit.count(address)) {
+        return;
+    }
+
+    const CellValue* before = tableModel.getCellValue(address);
+    pendingEdit.emplace(address, before ? std::optional<CellValue>(*before) : std::nullopt);
+}
+
+void TableViewModel::finishEdit() {
+    if (pendingEdit.empty()) {
+        return;
+    }
+
+    Edit edit;
+    edit.reserve(pendingEdit.size());
+    for (auto& [address, before] : pendingEdit) {
+        const CellValue* after = tableModel.getCellValue(address);
+        edit.push_back(CellDelta{ address, std::move(before), after ? std::optional<CellValue>(*after) : std::nullopt });
+    }
+    pendingEdit.clear();
+
+    if (!history.record(std::move(edit))) {
+        undoNote = "The change was too large for the undo history and can't be undone.";
+    }
+}
+
+std::string TableViewModel::takeUndoNote() {
+    return std::exchange(undoNote, std::string());
+}
+
+// - Cell updates
+
+void TableViewModel::setCell(const CellAddress& address, const CellValue& value) {
+    recordChange(address);
+    writeCell(address, value);
+}
+
+void TableViewModel::removeCell(const CellAddress& address) {
+    recordChange(address);
+    writeCell(address, std::nullopt);
+}
+
+// Updates the table without recording the change
+void TableViewModel::writeCell(const CellAddress& address, const std::optional<CellValue>& value) {
+    cancelRecalculation();
+
+    auto lock = recalculationWorker.lockTable();
+    if (value) {
+        tableModel.setCellValue(address, *value);
+        dependencyGraph.setCell(address, *value);
+    }
+    else {
+        tableModel.removeCellValue(address);
+        dependencyGraph.removeCell(address);
+    }
+    dirtyCells.insert(address);
+}
+
+void TableViewModel::rebuildDependencies() {
+    dependencyGraph.clear();
+    for (const auto& [address, value] : tableModel.getAllCells()) {
+        dependencyGraph.setCell(address, value);
+    }
+}
+
+// Imported cells are written without recording their previous values, so memory doesn't grow with the file.
+// The import can't be undone, and undoing the edits before it would mix old and imported cells, so they go too.
+void TableViewModel::applyImport(const ImportEvent& event) {
+    if (inTransaction) {
+        throw std::runtime_error("Cannot import inside a transaction");
+    }
+    // Changes applied before the import are their own edit
+    if (needsRecalculation()) {
+        flush();
+    }
+
+    TableParser::importCsv(event.fileName, [this](const CellAddress& address, CellValue value) {
+        writeCell(address, value);
+    });
+    history.clear();
+    undoNote = "Imports can't be undone, the undo history was cleared.";
+}
+
+void TableViewModel::applyFill(const FillEvent& event) {
+    const AddressRange& range = event.target;
+    for (size_t row = std::min(range.start.row, range.end.row); row <= std::max(range.start.row, range.end.row); ++row) {
+        for (size_t column = std::min(range.start.column, range.end.column); column <= std::max(range.start.column, range.end.column); ++column) {
+            setCell(CellAddress{ row, column }, CellValue{ event.value });
+        }
+    }
+}
+
+void TableViewModel::applyFillDown(const FillDownEvent& event) {
+    const AddressRange& range = event.target;
+    size_t firstRow = std::min(range.start.row, range.end.row);
+    size_t lastRow = std::max(range.start.row, range.end.row);
+
+    for (size_t column = std::min(range.start.column, range.end.column); column <= std::max(range.start.column, range.end.column); ++column) {
+        const CellValue* source = tableModel.getCellValue(CellAddress{ firstRow, column });
+
+        // Filling down an empty cell clears the rest of the column
+        if (!source) {
+            for (size_t row = firstRow + 1; row <= lastRow; ++row) {
+                removeCell(CellAddress{ row, column });
+            }
+            continue;
+        }
+
+        CellValue sourceValue = *source;
+        for (size_t row = firstRow + 1; row <= lastRow; ++row) {
+            setCell(CellAddress{ row, column }, sourceValue.offsetBy(static_cast<long long>(row - firstRow), 0));
+        }
+    }
+}
+
+void TableViewModel::applyPaste(const PasteEvent& event) {
+    for (size_t row = 0; row < event.rows.size(); ++row) {
+        for (size_t column = 0; column < event.rows[row].size(); ++column) {
+            if (event.rows[row][column]) {
+                setCell(CellAddress{ event.target.row + row, event.target.column + column }, CellValue{ *event.rows[row][column] });
+            }
+        }
+    }
+}
+
+void TableViewModel::applyScroll(const ScrollEvent& event) {
+    auto scrolled = [](size_t position, long long offset) -> size_t {
+        if (offset < 0 && static_cast<size_t>(-offset) > position) {
+            return 0;
+        }
+        return position + offset;
+    };
+
+    setViewportOrigin(CellAddress{ scrolled(viewportOrigin.row, event.rows), scrolled(viewportOrigin.column, event.columns) });
+}
+
+// - Displayable cells
+
+void TableViewModel::markAffectedCellsStale() {
+    if (dirtyCells.empty()) {
+        return;
+    }
+
+    for (const auto& address : dependencyGraph.collectAffected(dirtyCells)) {
+        if (staleCells.insert(address).second) {
+            staleCellsScheduled = false;
+            changes.cells.insert(address);
+        }
+        if (sheets) {
+            invalidatedCells.push_back(address);
+        }
+    }
+    dirtyCells.clear();
+}
+
+void TableViewModel::collectRecalculationResults() {
+    TraceSpan span("recalc", "collect results");
+    for (auto& [address, value] : recalculationWorker.takeResults()) {
+        if (staleCells.erase(address)) {
+            changes.cells.insert(address);
+        }
+        pendingCells.erase(address);
+        setDisplayValue(address, value);
+    }
+}
+
+// Updates the displayable table, noting what changed for the observers
+void TableViewModel::setDisplayValue(const CellAddress& address, const std::optional<std::string>& value) {
+    const std::string* current = displayableTableModel.getDisplayValue(address);
+    if (value ? (current && *current == *value) : !current) {
+        return;
+    }
+
+    size_t rowCount = displayableTableModel.getRowCount();
+    size_t columnCount = displayableTableModel.getColumnCount();
+    size_t maxLength = displayableTableModel.getMaxValueLength(address.column);
+
+    if (value) {
+        displayableTableModel.setDisplayValue(address, *value);
+    }
+    else {
+        displayableTableModel.removeDisplayValue(address);
+    }
+
+    changes.cells.insert(address);
+    if (displayableTableModel.getMaxValueLength(address.column) != maxLength) {
+        changes.resizedColumns.insert(address.column);
+    }
+    if (displayableTableModel.getRowCount() != rowCount || displayableTableModel.getColumnCount() != columnCount) {
+        changes.extentChanged = true;
+    }
+}
+
+void TableViewModel::setViewportOrigin(const CellAddress& origin) {
+    if (!(origin == viewportOrigin)) {
+        viewportOrigin = origin;
+        changes.viewportChanged = true;
+    }
+}
+
+void TableViewModel::notifyObservers() {
+    if (changes.empty()) {
+        return;
+    }
+
+    for (TableObserver* observer : observers) {
+        observer->tableChanged(changes);
+    }
+    changes = ChangeSet();
+}
+
+void TableViewModel::updateDisplayableCell(const CellAddress& address, CellEvaluator& evaluator) {
+    pendingCells.erase(address);
+
     const CellValue* cellValue = tableModel.getCellValue(address);
-    if (cellValue) {
-        CellEvaluator evaluator(tableModel);
-        displayableTableModel.setDisplayValue(address, evaluator.evaluate(*cellValue));
+    setDisplayValue(address, cellValue ? std::optional<std::string>(evaluator.evaluate(address, *cellValue)) : std::nullopt);
+}
+
+// Precedents outside the viewport are evaluated along the way, but only shown once they are in view
+void TableViewModel::evaluateViewport() {
+    if (pendingCells.empty()) {
+        return;
+    }
+    TraceSpan span("recalc", "evaluate viewport");
+
+    Viewport viewport = getViewport();
+
+    // Walk whichever is smaller, the pending cells or the viewport
+    std::vector<CellAddress> visiblePending;
+    if (pendingCells.size() < viewport.rows * viewport.columns) {
+        std::copy_if(pendingCells.begin(), pendingCells.end(), std::back_inserter(visiblePending), [&viewport](const CellAddress& address) {
+            return viewport.contains(address);
+        });
+    }
+    else {
+        for (size_t row = viewport.origin.row; row < viewport.origin.row + viewport.rows; ++row) {
+            for (size_t column = viewport.origin.column; column < viewport.origin.column + viewport.columns; ++column) {
+                CellAddress address{ row, column };
+                if (pendingCells.count(address)) {
+                    visiblePending.push_back(address);
+                }
+            }
+        }
+    }
+
+    CellEvaluator evaluator(tableModel, configuration.evaluationCacheSize, sheets);
+    for (const auto& address : visiblePending) {
+        updateDisplayableCell(address, evaluator);
     }
+    evaluationProfile.merge(evaluator.getProfile());
 }
 
-void TableViewModel::updateAllDisplayableCells() {
-    const auto& allCells = tableModel.getAllCells();
-    CellEvaluator evaluator(tableModel);
+void TableViewModel::evaluatePendingCells() {
+    TraceSpan span("recalc", "evaluate pending");
+    std::vector<CellAddress> pending(pendingCells.begin(), pendingCells.end());
 
-    for (const auto& [address, value] : allCells) {
-        displayableTableModel.setDisplayValue(address, evaluator.evaluate(value));
+    CellEvaluator evaluator(tableModel, configuration.evaluationCacheSize, sheets);
+    for (const auto& address : pending) {
+        updateDisplayableCell(address, evaluator);
     }
+    evaluationProfile.merge(evaluator.getProfile());
 }
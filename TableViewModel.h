@@ -5,13 +5,90 @@
 #include "DisplayableTableModel.h"
 #include "EventParser.h"
 #include "CellEvaluator.h"
+#include "DependencyGraph.h"
+#include "EditHistory.h"
+#include "RecalculationWorker.h"
+#include "TableObserver.h"
+#include <chrono>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <unordered_map>
+#include <optional>
+
+// Window of the table shown by the view: its top-left cell and how many rows and columns it covers
+struct Viewport {
+    CellAddress origin;
+    size_t rows;
+    size_t columns;
+
+    bool contains(const CellAddress& address) const;
+};
 
 class TableViewModel {
 public:
-    TableViewModel(TableConfiguration config, TableModel tableModel);
+    // A sheet of a workbook evaluates references to the other sheets through sheets,
+    // and shares their tableMutex, which keeps every sheet unchanged while any of them recalculates
+    TableViewModel(TableConfiguration config, TableModel tableModel, const SheetResolver* sheets = nullptr, std::shared_mutex* tableMutex = nullptr);
 
     void handle(const Event& event);
 
+    // Batch editing: apply() only mutates the table, displayable cells catch up on recalculate()
+    void apply(const Event& event);
+    void recalculate();
+    bool needsRecalculation() const;
+
+    // Evaluates every cell of the table again and waits for the result
+    void recalculateAll();
+
+    // Ends the current edit. Recalculates in automatic calculation mode,
+    // in manual mode the affected cells are only marked stale until the next recalculate().
+    void flush();
+
+    // Recalculation runs in the background, affected cells are stale until their new values are collected.
+    // Waiting collects whatever has been evaluated; returns true when no cell is stale anymore.
+    bool waitForRecalculation(std::chrono::milliseconds timeout);
+    void waitForRecalculation();
+    bool isRecalculating() const;
+    bool isStale(const CellAddress& address) const;
+
+    // Evaluates the cells not yet shown since the table was opened, so every cell has a display value
+    void evaluatePendingCells();
+
+    // Events inside a transaction are not recalculated until commit, rollback restores the cells touched since begin
+    void beginTransaction();
+    void commitTransaction();
+    void rollbackTransaction();
+    bool isInTransaction() const;
+
+    // Revert or reapply the latest edit, returns false when there is nothing to undo/redo
+    bool undo();
+    bool redo();
+    // Why the latest edit can't be undone, once, empty when it can: an import, or an edit too large for the history
+    std::string takeUndoNote();
+
+    // Sized by the configuration: grows with the table from the initial size up to the max size
+    Viewport getViewport() const;
+
+    // - Sheets of a workbook
+    // Cells reading any of the given cells of another sheet, or anything on it
+    std::vector<CellAddress> collectSheetDependents(const std::string& sheet, const std::vector<CellAddress>& cells) const;
+    std::vector<CellAddress> collectSheetDependents(const std::string& sheet) const;
+    // Recalculates cells whose precedents on another sheet changed, like an edit that is not recorded for undo
+    void invalidate(const std::vector<CellAddress>& cells);
+    // Cells marked stale since the last call, whose dependents on other sheets are to be invalidated in turn
+    std::vector<CellAddress> takeInvalidatedCells();
+    // Drops the running recalculation, its remaining cells stay stale until the next one
+    void cancelRecalculation();
+
+    // Observers are told what changed after each handled event and each collection of recalculated values
+    void addObserver(TableObserver& observer);
+    void removeObserver(TableObserver& observer);
+
+    // Evaluations in the background and for the viewport so far, empty unless built with EVALUATION_PROFILING
+    EvaluationProfile getEvaluationProfile();
+
     const TableConfiguration& getConfiguration() const;
     const TableModel& getTableModel() const;
     const DisplayableTableModel& getDisplayableTableModel() const;
@@ -19,8 +96,58 @@ public:
 private:
     TableConfiguration configuration;
     TableModel tableModel;
+    const SheetResolver* sheets;
     DisplayableTableModel displayableTableModel;
+    DependencyGraph dependencyGraph;
+    RecalculationWorker recalculationWorker;
+    EvaluationProfile evaluationProfile;
+
+    // Cells changed since the last recalculation, only they and their dependents are evaluated again
+    std::unordered_set<CellAddress> dirtyCells;
+    // Cells whose display value predates the latest edit, waiting for the recalculation worker
+    std::unordered_set<CellAddress> staleCells;
+    bool staleCellsScheduled = false;
+
+    // Value of every cell touched by the current edit before its first change, nullopt for cells that were empty.
+    // The edit ends with the recalculation of a handled event or batch, or with its transaction.
+    std::unordered_map<CellAddress, std::optional<CellValue>> pendingEdit;
+    EditHistory history;
+    bool inTransaction = false;
+    std::string undoNote;
+
+    CellAddress viewportOrigin{ 0, 0 };
+
+    // Only kept for a sheet of a workbook, see takeInvalidatedCells()
+    std::vector<CellAddress> invalidatedCells;
+
+    std::vector<TableObserver*> observers;
+    ChangeSet changes;
+
+    // Cells not evaluated since the table was opened. They are evaluated when they come into the viewport,
+    // when an export needs every value, or when a recalculation reaches them.
+    std::unordered_set<CellAddress> pendingCells;
+    // Last row and column holding a pending cell, so the viewport still grows with the whole table
+    CellAddress pendingExtent{ 0, 0 };
+
+    void recordChange(const CellAddress& address);
+    void finishEdit();
+    void writeCell(const CellAddress& address, const std::optional<CellValue>& value);
+
+    void setCell(const CellAddress& address, const CellValue& value);
+    void removeCell(const CellAddress& address);
+    void rebuildDependencies();
+
+    void applyFill(const FillEvent& event);
+    void applyFillDown(const FillDownEvent& event);
+    void applyPaste(const PasteEvent& event);
+    void applyImport(const ImportEvent& event);
+    void applyScroll(const ScrollEvent& event);
 
-    void updateDisplayableCell(const CellAddress& address);
-    void updateAllDisplayableCells();
+    void markAffectedCellsStale();
+    void collectRecalculationResults();
+    void setDisplayValue(const CellAddress& address, const std::optional<std::string>& value);
+    void setViewportOrigin(const CellAddress& origin);
+    void notifyObservers();
+    void updateDisplayableCell(const CellAddress& address, CellEvaluator& evaluator);
+    void evaluateViewport();
 };
@@ -0,0 +1,147 @@
+#include "Tracer.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+struct Span {
+    const char* category;
+    const char* name;
+    uint32_t thread;
+    Tracer::Clock::time_point begin;
+    Tracer::Clock::time_point end;
+};
+
+struct TraceState {
+    std::atomic<bool> recording{ false };
+    std::mutex mutex;
+    std::string fileName;
+    Tracer::Clock::time_point started;
+    std::vector<Span> spans;
+    std::map<uint32_t, std::string> threadNames;
+};
+
+TraceState& state() {
+    static TraceState traceState;
+    return traceState;
+}
+
+// Small sequential thread ids keep the tracks in the order the threads were first seen
+uint32_t currentThread() {
+    static std::atomic<uint32_t> nextThread{ 1 };
+    thread_local uint32_t thread = nextThread++;
+    return thread;
+}
+
+double microseconds(Tracer::Clock::duration duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+// Thread names are set by the application, only quotes and backslashes need escaping
+std::string escape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+}
+
+void Tracer::start(const std::string& fileName) {
+    TraceState& trace = state();
+    std::lock_guard<std::mutex> lock(trace.mutex);
+    if (trace.recording) {
+        throw std::runtime_error("Already tracing to '" + trace.fileName + "'");
+    }
+
+    trace.fileName = fileName;
+    trace.started = Clock::now();
+    trace.spans.clear();
+    trace.recording = true;
+}
+
+std::string Tracer::stop() {
+    TraceState& trace = state();
+    std::lock_guard<std::mutex> lock(trace.mutex);
+    if (!trace.recording) {
+        throw std::runtime_error("No trace is running");
+    }
+
+    // The trace keeps running when its file can't be opened, so nothing recorded is lost
+    std::ofstream out(trace.fileName);
+    if (!out) {
+        throw std::runtime_error("Could not write trace to '" + trace.fileName + "'");
+    }
+
+    trace.recording = false;
+    std::vector<Span> spans;
+    spans.swap(trace.spans);
+
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    bool first = true;
+    for (const auto& [thread, name] : trace.threadNames) {
+        out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread
+            << ",\"args\":{\"name\":\"" << escape(name) << "\"}}";
+        first = false;
+    }
+    for (const Span& span : spans) {
+        // Spans opened before the trace started are cut off at its start
+        Clock::time_point begin = std::max(span.begin, trace.started);
+        out << (first ? "" : ",\n") << "{\"name\":\"" << span.name << "\",\"cat\":\"" << span.category
+            << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << span.thread
+            << ",\"ts\":" << microseconds(begin - trace.started) << ",\"dur\":" << microseconds(span.end - begin) << "}";
+        first = false;
+    }
+    out << "\n]}\n";
+
+    if (!out) {
+        throw std::runtime_error("Could not write trace to '" + trace.fileName + "'");
+    }
+    return trace.fileName;
+}
+
+bool Tracer::isRecording() {
+    return state().recording.load(std::memory_order_relaxed);
+}
+
+void Tracer::setThreadName(const std::string& name) {
+    TraceState& trace = state();
+    uint32_t thread = currentThread();
+    std::lock_guard<std::mutex> lock(trace.mutex);
+    trace.threadNames[thread] = name;
+}
+
+void Tracer::record(const char* category, const char* name, Clock::time_point begin, Clock::time_point end) {
+    TraceState& trace = state();
+    uint32_t thread = currentThread();
+    std::lock_guard<std::mutex> lock(trace.mutex);
+
+    // The trace may have been stopped while the span was open
+    if (trace.recording) {
+        trace.spans.push_back(Span{ category, name, thread, begin, end });
+    }
+}
+
+TraceSpan::TraceSpan(const char* category, const char* name)
+    : category(category), name(name), recording(Tracer::isRecording()) {
+    if (recording) {
+        begin = Tracer::Clock::now();
+    }
+}
+
+TraceSpan::~TraceSpan() {
+    if (recording) {
+        Tracer::record(category, name, begin, Tracer::Clock::now());
+    }
+}
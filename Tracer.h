@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+// Records timed spans of every thread while a trace is running and writes them as Chrome trace-event JSON,
+// which chrome://tracing and Perfetto show with one track per thread.
+// Spans are only timed while recording, otherwise a span costs a single flag check.
+class Tracer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Starts recording spans to be written to fileName, throws when a trace is already running
+    static void start(const std::string& fileName);
+    // Writes the recorded spans and stops recording. Throws when the file can't be written,
+    // if it can't even be opened the trace keeps recording and stop() can be retried
+    static std::string stop();
+    static bool isRecording();
+
+    // Name of the calling thread's track
+    static void setThreadName(const std::string& name);
+
+    static void record(const char* category, const char* name, Clock::time_point begin, Clock::time_point end);
+};
+
+// Records the time from its construction to the end of its scope. Names must outlive the trace, use literals.
+class TraceSpan {
+public:
+    TraceSpan(const char* category, const char* name);
+    ~TraceSpan();
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* category;
+    const char* name;
+    bool recording;
+    Tracer::Clock::time_point begin;
+};
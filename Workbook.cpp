@@ -0,0 +1,249 @@
+#include "Workbook.h"
+#include "TableParser.h"
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_set>
+
+const std::string Workbook::defaultSheetName = "Sheet1";
+
+static bool isValidSheetName(const std::string& name) {
+    return !name.empty() && std::all_of(name.begin(), name.end(), [](char c) {
+        return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_';
+    });
+}
+
+Workbook::Workbook(TableConfiguration config, std::vector<std::pair<std::string, TableModel>> sheets)
+    : configuration(std::move(config)) {
+    if (sheets.empty()) {
+        sheets.emplace_back(defaultSheetName, TableModel());
+    }
+    for (auto& [name, tableModel] : sheets) {
+        addSheet(name, std::move(tableModel));
+    }
+}
+
+Workbook::Workbook(TableConfiguration config, TableModel tableModel)
+    : configuration(std::move(config)) {
+    addSheet(defaultSheetName, std::move(tableModel));
+}
+
+// Recalculation threads of one sheet may read any other, so they all stop before the first sheet goes away
+Workbook::~Workbook() {
+    std::unique_lock<std::shared_mutex> lock(tableMutex);
+    for (auto& sheet : sheets) {
+        sheet.viewModel->cancelRecalculation();
+    }
+}
+
+void Workbook::handle(const Event& event) {
+    if (handleSheetEvent(event)) {
+        return;
+    }
+
+    // Stale cells of every sheet, in manual calculation mode
+    if (std::holds_alternative<CalculateEvent>(event)) {
+        for (auto& sheet : sheets) {
+            sheet.viewModel->handle(event);
+        }
+    }
+    else {
+        getActiveSheet().handle(event);
+    }
+    invalidateDependents();
+}
+
+void Workbook::apply(const Event& event) {
+    if (handleSheetEvent(event)) {
+        return;
+    }
+
+    if (std::holds_alternative<CalculateEvent>(event)) {
+        for (auto& sheet : sheets) {
+            sheet.viewModel->apply(event);
+        }
+        invalidateDependents();
+    }
+    else {
+        // Exported values read other sheets, whose changes so far have to reach the active sheet first
+        if (std::holds_alternative<ExportEvent>(event) && needsRecalculation()) {
+            flush();
+        }
+        getActiveSheet().apply(event);
+    }
+}
+
+bool Workbook::handleSheetEvent(const Event& event) {
+    if (auto e = std::get_if<SheetEvent>(&event)) {
+        selectSheet(e->name);
+        return true;
+    }
+    if (auto e = std::get_if<AddSheetEvent>(&event)) {
+        if (getActiveSheet().isInTransaction()) {
+            throw std::runtime_error("Cannot add sheets inside a transaction");
+        }
+        addSheet(e->name);
+        selectSheet(e->name);
+        return true;
+    }
+    return false;
+}
+
+bool Workbook::needsRecalculation() const {
+    return std::any_of(sheets.begin(), sheets.end(), [](const Sheet& sheet) {
+        return sheet.viewModel->needsRecalculation();
+    });
+}
+
+void Workbook::flush() {
+    for (auto& sheet : sheets) {
+        if (sheet.viewModel->needsRecalculation()) {
+            sheet.viewModel->flush();
+        }
+    }
+    invalidateDependents();
+}
+
+bool Workbook::waitForRecalculation(std::chrono::milliseconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    bool finished = true;
+    for (auto& sheet : sheets) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        finished = sheet.viewModel->waitForRecalculation(std::max(remaining, std::chrono::milliseconds(0))) && finished;
+    }
+    return finished;
+}
+
+void Workbook::waitForRecalculation() {
+    for (auto& sheet : sheets) {
+        sheet.viewModel->waitForRecalculation();
+    }
+}
+
+bool Workbook::isRecalculating() const {
+    return std::any_of(sheets.begin(), sheets.end(), [](const Sheet& sheet) {
+        return sheet.viewModel->isRecalculating();
+    });
+}
+
+TableViewModel& Workbook::selectSheet(const std::string& name) {
+    if (getActiveSheet().isInTransaction()) {
+        throw std::runtime_error("Cannot switch sheets inside a transaction");
+    }
+
+    auto it = std::find_if(sheets.begin(), sheets.end(), [&name](const Sheet& sheet) { return sheet.name == name; });
+    if (it == sheets.end()) {
+        throw std::runtime_error("No sheet named '" + name + "', 'addsheet " + name + "' adds one");
+    }
+    activeSheet = static_cast<size_t>(it - sheets.begin());
+    return *it->viewModel;
+}
+
+TableViewModel& Workbook::addSheet(const std::string& name, TableModel tableModel) {
+    if (!isValidSheetName(name)) {
+        throw std::invalid_argument("Invalid sheet name '" + name + "', use letters, digits and '_'");
+    }
+    if (getSheet(name)) {
+        throw std::invalid_argument("Sheet '" + name + "' already exists");
+    }
+
+    auto viewModel = std::make_unique<TableViewModel>(configuration, std::move(tableModel), this, &tableMutex);
+    {
+        // Recalculation threads look sheets up while they evaluate
+        std::unique_lock<std::shared_mutex> lock(tableMutex);
+        sheets.push_back(Sheet{ name, std::move(viewModel) });
+    }
+
+    // Cells that read the sheet before it existed show #REF!, the new sheet's references to itself included
+    for (auto& sheet : sheets) {
+        sheet.viewModel->invalidate(sheet.viewModel->collectSheetDependents(name));
+    }
+    invalidateDependents();
+    return *sheets.back().viewModel;
+}
+
+TableViewModel& Workbook::getActiveSheet() {
+    return *sheets[activeSheet].viewModel;
+}
+
+const TableViewModel& Workbook::getActiveSheet() const {
+    return *sheets[activeSheet].viewModel;
+}
+
+const std::string& Workbook::getActiveSheetName() const {
+    return sheets[activeSheet].name;
+}
+
+TableViewModel* Workbook::getSheet(const std::string& name) {
+    for (auto& sheet : sheets) {
+        if (sheet.name == name) {
+            return sheet.viewModel.get();
+        }
+    }
+    return nullptr;
+}
+
+std::vector<std::string> Workbook::getSheetNames() const {
+    std::vector<std::string> names;
+    for (const auto& sheet : sheets) {
+        names.push_back(sheet.name);
+    }
+    return names;
+}
+
+bool Workbook::save(const std::string& fileName) const {
+    if (sheets.size() == 1 && sheets.front().name == defaultSheetName && !TableParser::hasWorkbookExtension(fileName)) {
+        return TableParser::save(sheets.front().viewModel->getTableModel(), fileName);
+    }
+
+    std::vector<std::pair<std::string, const TableModel*>> tables;
+    for (const auto& sheet : sheets) {
+        tables.emplace_back(sheet.name, &sheet.viewModel->getTableModel());
+    }
+    return TableParser::saveWorkbook(tables, fileName);
+}
+
+// Called by the recalculation threads of every sheet, under a shared lock of tableMutex
+const TableModel* Workbook::findSheet(const std::string& name) const {
+    for (const auto& sheet : sheets) {
+        if (sheet.name == name) {
+            return &sheet.viewModel->getTableModel();
+        }
+    }
+    return nullptr;
+}
+
+// Cells invalidated on one sheet invalidate the cells of the sheets reading them, until no sheet has new ones.
+// Each cell is invalidated at most once per call, which also ends the propagation around circular references.
+void Workbook::invalidateDependents() {
+    std::vector<std::pair<size_t, std::vector<CellAddress>>> pending;
+    for (size_t i = 0; i < sheets.size(); ++i) {
+        std::vector<CellAddress> cells = sheets[i].viewModel->takeInvalidatedCells();
+        if (!cells.empty()) {
+            pending.emplace_back(i, std::move(cells));
+        }
+    }
+
+    std::vector<std::unordered_set<CellAddress>> invalidated(sheets.size());
+    while (!pending.empty()) {
+        auto [source, cells] = std::move(pending.back());
+        pending.pop_back();
+
+        for (size_t i = 0; i < sheets.size(); ++i) {
+            std::vector<CellAddress> dependents;
+            for (const auto& address : sheets[i].viewModel->collectSheetDependents(sheets[source].name, cells)) {
+                if (invalidated[i].insert(address).second) {
+                    dependents.push_back(address);
+                }
+            }
+            if (dependents.empty()) {
+                continue;
+            }
+
+            sheets[i].viewModel->invalidate(dependents);
+            std::vector<CellAddress> next = sheets[i].viewModel->takeInvalidatedCells();
+            if (!next.empty()) {
+                pending.emplace_back(i, std::move(next));
+            }
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "CellEvaluator.h"
+#include "Event.h"
+#include "TableConfiguration.h"
+#include "TableModel.h"
+#include "TableViewModel.h"
+
+// Named sheets, each a TableViewModel with its own recalculation threads, so independent sheets recalculate
+// in parallel. Formulas and references read other sheets as {sheet}!A1; a change only invalidates the cells
+// of the sheets reading it, directly or through other sheets, the rest of the workbook is left alone.
+// Events go to the active sheet, a SheetEvent switches it and an AddSheetEvent adds one.
+class Workbook : public SheetResolver {
+public:
+    static const std::string defaultSheetName;
+
+    // The first sheet is active, sheet names are [A-Za-z0-9_]+
+    Workbook(TableConfiguration config, std::vector<std::pair<std::string, TableModel>> sheets);
+    // A single sheet named defaultSheetName
+    explicit Workbook(TableConfiguration config, TableModel tableModel = TableModel());
+    ~Workbook() override;
+
+    Workbook(const Workbook&) = delete;
+    Workbook& operator=(const Workbook&) = delete;
+
+    // TableViewModel::handle() on the active sheet, then recalculates the cells of other sheets reading what changed
+    void handle(const Event& event);
+
+    // Batch editing: apply() changes the active sheet, flush() recalculates every sheet with changes and its dependents
+    void apply(const Event& event);
+    bool needsRecalculation() const;
+    void flush();
+
+    // Waits for every sheet, returns true when no cell of any sheet is stale anymore
+    bool waitForRecalculation(std::chrono::milliseconds timeout);
+    void waitForRecalculation();
+    bool isRecalculating() const;
+
+    // Makes the sheet active, throws when there is none of that name so a typo doesn't add a sheet
+    TableViewModel& selectSheet(const std::string& name);
+    TableViewModel& addSheet(const std::string& name, TableModel tableModel = TableModel());
+
+    TableViewModel& getActiveSheet();
+    const TableViewModel& getActiveSheet() const;
+    const std::string& getActiveSheetName() const;
+    // nullptr when there is no sheet of that name
+    TableViewModel* getSheet(const std::string& name);
+    std::vector<std::string> getSheetNames() const;
+
+    // A lone default sheet is saved as a plain table file unless the name has the workbook extension,
+    // anything else as a workbook file
+    bool save(const std::string& fileName) const;
+
+    const TableModel* findSheet(const std::string& name) const override;
+
+private:
+    struct Sheet {
+        std::string name;
+        std::unique_ptr<TableViewModel> viewModel;
+    };
+
+    const TableConfiguration configuration;
+
+    // Held exclusively while any sheet changes, shared by the recalculation threads of all sheets while they evaluate
+    std::shared_mutex tableMutex;
+    std::vector<Sheet> sheets;
+    size_t activeSheet = 0;
+
+    // Handles SheetEvent and AddSheetEvent, returns false for events of the active sheet
+    bool handleSheetEvent(const Event& event);
+    void invalidateDependents();
+};
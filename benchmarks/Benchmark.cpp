@@ -0,0 +1,346 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "CellAddress.h"
+#include "CellEvaluator.h"
+#include "EventParser.h"
+#include "TableConfiguration.h"
+#include "TableModel.h"
+#include "TableParser.h"
+#include "TableView.h"
+#include "TableViewModel.h"
+
+// Times the hot paths on a synthetic table and prints the results as JSON:
+//   bench [--rows N] [--cols N] [--formula-density F] [--chain-depth N] [--range-size N]
+//         [--string-ratio F] [--iterations N] [--threads N] [--seed N] [--output FILE]
+
+// - Parameters
+
+struct BenchmarkParameters {
+    size_t rows = 2000;
+    size_t columns = 26;
+    double formulaDensity = 0.3; // share of cells holding a reference or formula
+    size_t chainDepth = 8;       // longest chain of cells referencing the cell above
+    size_t rangeSize = 16;       // rows covered by each range formula
+    double stringRatio = 0.1;    // share of cells holding text
+    size_t iterations = 1000;    // repetitions of the cheap operations
+    int threads = 1;
+    unsigned seed = 1;
+    std::string outputFile;
+};
+
+struct BenchmarkResult {
+    std::string name;
+    size_t iterations;
+    double seconds;
+    size_t itemsPerIteration; // cells, lines or bytes handled by one iteration
+};
+
+static BenchmarkParameters parseArguments(int argc, char* argv[]) {
+    BenchmarkParameters parameters;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string name = argv[i];
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for " + name);
+        }
+        std::string value = argv[++i];
+
+        if (name == "--rows") parameters.rows = std::stoul(value);
+        else if (name == "--cols") parameters.columns = std::stoul(value);
+        else if (name == "--formula-density") parameters.formulaDensity = std::stod(value);
+        else if (name == "--chain-depth") parameters.chainDepth = std::stoul(value);
+        else if (name == "--range-size") parameters.rangeSize = std::stoul(value);
+        else if (name == "--string-ratio") parameters.stringRatio = std::stod(value);
+        else if (name == "--iterations") parameters.iterations = std::stoul(value);
+        else if (name == "--threads") parameters.threads = std::stoi(value);
+        else if (name == "--seed") parameters.seed = static_cast<unsigned>(std::stoul(value));
+        else if (name == "--output") parameters.outputFile = value;
+        else throw std::invalid_argument("Unknown option " + name);
+    }
+
+    if (parameters.rows == 0 || parameters.columns == 0 || parameters.iterations == 0 || parameters.threads < 1) {
+        throw std::invalid_argument("rows, cols, iterations and threads must be positive");
+    }
+    return parameters;
+}
+
+// - Workload generation
+
+static const FormulaType rangeFormulaTypes[] = { FormulaType::SUM, FormulaType::AVERAGE, FormulaType::MIN, FormulaType::MAX, FormulaType::COUNT };
+
+static std::string formulaName(FormulaType type) {
+    switch (type) {
+    case FormulaType::SUM: return "SUM";
+    case FormulaType::AVERAGE: return "AVERAGE";
+    case FormulaType::MIN: return "MIN";
+    case FormulaType::MAX: return "MAX";
+    case FormulaType::CONCAT: return "CONCAT";
+    case FormulaType::SUBSTR: return "SUBSTR";
+    case FormulaType::LEN: return "LEN";
+    case FormulaType::COUNT: return "COUNT";
+    }
+    return "SUM";
+}
+
+// Formulas read the column above them: references build chains of at most chainDepth cells,
+// range formulas cover up to rangeSize rows
+static TableModel generateTable(const BenchmarkParameters& parameters) {
+    std::mt19937 random(parameters.seed);
+    std::uniform_real_distribution<double> share(0.0, 1.0);
+    std::uniform_int_distribution<int> number(0, 9999);
+
+    TableModel table;
+    for (size_t row = 0; row < parameters.rows; ++row) {
+        for (size_t column = 0; column < parameters.columns; ++column) {
+            CellAddress address{ row, column };
+            double kind = share(random);
+
+            if (kind < parameters.stringRatio) {
+                table.setCellValue(address, CellValue{ LiteralValue{ "s" + std::to_string(row) + "x" + std::to_string(column) } });
+            }
+            else if (kind < parameters.stringRatio + parameters.formulaDensity && row > 0) {
+                bool reference = parameters.chainDepth > 1 && row % parameters.chainDepth != 0 && share(random) < 0.5;
+                if (reference) {
+                    table.setCellValue(address, CellValue{ CellAddress{ row - 1, column } });
+                }
+                else {
+                    size_t firstRow = row > parameters.rangeSize ? row - parameters.rangeSize : 0;
+                    FormulaType type = rangeFormulaTypes[(row + column) % std::size(rangeFormulaTypes)];
+                    table.setCellValue(address, CellValue{ FormulaValue{ type, { AddressRange{ CellAddress{ firstRow, column }, CellAddress{ row - 1, column } } } } });
+                }
+            }
+            else {
+                table.setCellValue(address, CellValue{ LiteralValue{ static_cast<double>(number(random)) } });
+            }
+        }
+    }
+    return table;
+}
+
+// The command a user would type to create the cell
+static std::string toCommand(const CellAddress& address, const CellValue& value) {
+    std::string target = address.toString();
+
+    if (auto literal = std::get_if<LiteralValue>(&value.value)) {
+        if (auto text = std::get_if<std::string>(&literal->value)) {
+            return target + " insert \"" + *text + "\"";
+        }
+        if (auto flag = std::get_if<bool>(&literal->value)) {
+            return target + " insert " + (*flag ? "TRUE" : "FALSE");
+        }
+        return target + " insert " + std::to_string(static_cast<long long>(std::get<double>(literal->value)));
+    }
+    if (auto reference = std::get_if<CellAddress>(&value.value)) {
+        return target + "=" + reference->toString();
+    }
+
+    const FormulaValue& formula = std::get<FormulaValue>(value.value);
+    std::string command = target + "=" + formulaName(formula.type) + "(";
+    for (size_t i = 0; i < formula.parameters.size(); ++i) {
+        if (i > 0) command += ",";
+        if (auto range = std::get_if<AddressRange>(&formula.parameters[i])) {
+            command += range->start.toString() + ":" + range->end.toString();
+        }
+        else if (auto cell = std::get_if<CellAddress>(&formula.parameters[i])) {
+            command += cell->toString();
+        }
+    }
+    return command + ")";
+}
+
+// - Measurement
+
+template <typename Operation>
+static BenchmarkResult measure(const std::string& name, size_t iterations, size_t itemsPerIteration, Operation operation) {
+    std::cerr << "Running " << name << "...\n";
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        operation(i);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return BenchmarkResult{ name, iterations, elapsed.count(), itemsPerIteration };
+}
+
+// Points stdout at /dev/null while alive, so rendering is timed without a terminal
+class NullOutput {
+public:
+    NullOutput() {
+        std::cout.flush();
+        savedOutput = dup(STDOUT_FILENO);
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        close(null);
+    }
+
+    ~NullOutput() {
+        std::cout.flush();
+        dup2(savedOutput, STDOUT_FILENO);
+        close(savedOutput);
+    }
+
+private:
+    int savedOutput;
+};
+
+static std::vector<BenchmarkResult> runBenchmarks(const BenchmarkParameters& parameters) {
+    std::vector<BenchmarkResult> results;
+    std::mt19937 random(parameters.seed + 1);
+
+    TableModel table = generateTable(parameters);
+    size_t cellCount = table.getAllCells().size();
+
+    // Parsing
+    std::vector<std::string> commands;
+    commands.reserve(cellCount);
+    for (const auto& [address, value] : table.getAllCells()) {
+        commands.push_back(toCommand(address, value));
+    }
+    results.push_back(measure("parse", parameters.iterations, commands.size() > 1000 ? 1000 : commands.size(), [&](size_t i) {
+        size_t offset = (i * 1000) % commands.size();
+        for (size_t line = 0; line < 1000 && line < commands.size(); ++line) {
+            EventParser::parse(commands[(offset + line) % commands.size()]);
+        }
+    }));
+
+    // Loading and saving
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    for (const std::string& extension : { std::string(".txt"), std::string(".xlsnap") }) {
+        std::string fileName = (directory / ("excel-benchmark" + extension)).string();
+        std::string format = extension == ".txt" ? "text" : "snapshot";
+
+        results.push_back(measure("save_" + format, 5, cellCount, [&](size_t) {
+            if (!TableParser::save(table, fileName)) {
+                throw std::runtime_error("Could not save " + fileName);
+            }
+        }));
+        results.push_back(measure("load_" + format, 5, cellCount, [&](size_t) {
+            TableParser::load(fileName);
+        }));
+        std::filesystem::remove(fileName);
+    }
+
+    TableConfiguration config{ 10, 10, 50, 20, true, 15, Alignment::Left, true };
+    config.recalcThreads = parameters.threads;
+    TableViewModel viewModel(config, table);
+
+    // Recalculation
+    results.push_back(measure("recalc_full", 5, cellCount, [&](size_t) {
+        viewModel.recalculateAll();
+    }));
+
+    // Edits of literal cells, whose dependents have to be recalculated
+    std::vector<CellAddress> literals;
+    for (const auto& [address, value] : table.getAllCells()) {
+        if (value.isLiteral()) literals.push_back(address);
+    }
+    if (!literals.empty()) {
+        std::uniform_int_distribution<size_t> pick(0, literals.size() - 1);
+        results.push_back(measure("recalc_incremental", parameters.iterations, 1, [&](size_t i) {
+            viewModel.handle(InsertEvent{ literals[pick(random)], LiteralValue{ static_cast<double>(i) } });
+            viewModel.waitForRecalculation();
+        }));
+    }
+
+    // Range functions over one column
+    size_t rangeRows = std::min(parameters.rows, parameters.rangeSize);
+    AddressRange range{ CellAddress{ 0, 0 }, CellAddress{ rangeRows - 1, 0 } };
+    for (FormulaType type : { FormulaType::SUM, FormulaType::AVERAGE, FormulaType::MIN, FormulaType::MAX, FormulaType::COUNT, FormulaType::CONCAT }) {
+        std::vector<FormulaParam> arguments{ range };
+        if (type == FormulaType::CONCAT) {
+            arguments.push_back(LiteralValue{ std::string(",") });
+        }
+        CellValue formula{ FormulaValue{ type, arguments } };
+        results.push_back(measure("evaluate_" + formulaName(type), parameters.iterations, rangeRows, [&](size_t) {
+            CellEvaluator evaluator(viewModel.getTableModel());
+            evaluator.evaluate(formula);
+        }));
+    }
+
+    // Rendering
+    {
+        TableView view(viewModel);
+        NullOutput nullOutput;
+        results.push_back(measure("redraw", parameters.iterations / 10 + 1, config.maxTableRows * config.maxTableCols, [&](size_t) {
+            view.invalidate();
+            view.redraw();
+        }));
+    }
+
+    return results;
+}
+
+// - Output
+
+static void writeJson(std::ostream& out, const BenchmarkParameters& parameters, const std::vector<BenchmarkResult>& results) {
+    out << std::setprecision(9);
+    out << "{\n";
+    out << "  \"parameters\": {"
+        << "\"rows\": " << parameters.rows
+        << ", \"cols\": " << parameters.columns
+        << ", \"formulaDensity\": " << parameters.formulaDensity
+        << ", \"chainDepth\": " << parameters.chainDepth
+        << ", \"rangeSize\": " << parameters.rangeSize
+        << ", \"stringRatio\": " << parameters.stringRatio
+        << ", \"iterations\": " << parameters.iterations
+        << ", \"threads\": " << parameters.threads
+        << ", \"seed\": " << parameters.seed << "},\n";
+
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult& result = results[i];
+        double perIteration = result.seconds / result.iterations;
+        out << "    {\"name\": \"" << result.name << "\""
+            << ", \"iterations\": " << result.iterations
+            << ", \"seconds\": " << result.seconds
+            << ", \"nsPerIteration\": " << perIteration * 1e9
+            << ", \"itemsPerIteration\": " << result.itemsPerIteration
+            << ", \"nsPerItem\": " << perIteration * 1e9 / std::max<size_t>(result.itemsPerIteration, 1) << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n";
+    out << "}\n";
+}
+
+// - MAIN
+
+int main(int argc, char* argv[]) {
+    try {
+        BenchmarkParameters parameters = parseArguments(argc, argv);
+        std::vector<BenchmarkResult> results = runBenchmarks(parameters);
+
+        if (parameters.outputFile.empty()) {
+            writeJson(std::cout, parameters, results);
+        }
+        else {
+            std::ofstream output(parameters.outputFile);
+            if (!output) {
+                throw std::runtime_error("Could not open " + parameters.outputFile);
+            }
+            writeJson(output, parameters, results);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Benchmark failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
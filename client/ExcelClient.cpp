@@ -0,0 +1,135 @@
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Sends commands from stdin to a server started with 'excel --serve', one at a time, and prints every
+// line the server sends: the replies and the changes made by all clients. Works interactively or with
+// a script piped in, and disconnects once stdin ends and the last command has been answered:
+//   client {socket}
+
+static int connectTo(const std::string& socketPath) {
+    sockaddr_un address{};
+    if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Invalid socket path '" + socketPath + "'");
+    }
+    address.sun_family = AF_UNIX;
+    socketPath.copy(address.sun_path, socketPath.size());
+
+    int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection < 0 || connect(connection, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        throw std::runtime_error("Could not connect to '" + socketPath + "'");
+    }
+    return connection;
+}
+
+static void sendLine(int connection, std::string line) {
+    line += '\n';
+    size_t sent = 0;
+    while (sent < line.size()) {
+        ssize_t written = send(connection, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+        if (written <= 0) {
+            throw std::runtime_error("Connection lost");
+        }
+        sent += static_cast<size_t>(written);
+    }
+}
+
+// A command is answered by its 'ok' or 'error' line, anything before it is a value or a change
+static bool isReply(const std::string& line) {
+    return line == "ok" || line.rfind("error", 0) == 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        std::cerr << "Usage: client {socket}" << std::endl;
+        return 2;
+    }
+
+    try {
+        int connection = connectTo(argv[1]);
+
+        std::string received;
+        std::string input;
+        bool waitingForReply = false;
+        bool inputEnded = false;
+        char chunk[4096];
+
+        bool quit = false;
+        while (!quit) {
+            // Next complete command, a last line without newline counts once stdin has ended
+            if (!waitingForReply) {
+                size_t lineEnd = input.find('\n');
+                if (lineEnd == std::string::npos && inputEnded && !input.empty()) {
+                    lineEnd = input.size();
+                }
+                if (lineEnd != std::string::npos) {
+                    std::string line = input.substr(0, lineEnd);
+                    input.erase(0, lineEnd + 1);
+                    if (!line.empty() && line.back() == '\r') line.pop_back();
+                    if (line == "quit") {
+                        quit = true;
+                        continue;
+                    }
+                    if (!line.empty()) {
+                        sendLine(connection, line);
+                        waitingForReply = true;
+                    }
+                    continue;
+                }
+            }
+            if (inputEnded && !waitingForReply) {
+                break;
+            }
+
+            // stdin is only read while no command is outstanding, so replies stay in order
+            pollfd sources[2] = { { connection, POLLIN, 0 }, { STDIN_FILENO, POLLIN, 0 } };
+            nfds_t count = waitingForReply || inputEnded ? 1 : 2;
+            if (poll(sources, count, -1) < 0) {
+                continue;
+            }
+
+            if (sources[0].revents) {
+                ssize_t length = recv(connection, chunk, sizeof(chunk), 0);
+                if (length <= 0) {
+                    std::cout << "Server closed the connection" << std::endl;
+                    close(connection);
+                    return 1;
+                }
+                received.append(chunk, static_cast<size_t>(length));
+
+                size_t lineEnd;
+                while ((lineEnd = received.find('\n')) != std::string::npos) {
+                    std::string line = received.substr(0, lineEnd);
+                    received.erase(0, lineEnd + 1);
+                    std::cout << line << std::endl;
+                    if (isReply(line)) {
+                        waitingForReply = false;
+                    }
+                }
+            }
+
+            if (count == 2 && sources[1].revents) {
+                ssize_t length = read(STDIN_FILENO, chunk, sizeof(chunk));
+                if (length <= 0) {
+                    inputEnded = true;
+                }
+                else {
+                    input.append(chunk, static_cast<size_t>(length));
+                }
+            }
+        }
+
+        sendLine(connection, "quit");
+        close(connection);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Client failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
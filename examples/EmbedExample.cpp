@@ -0,0 +1,119 @@
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "CellAddress.h"
+#include "EventParser.h"
+#include "Spreadsheet.h"
+#include "TableModel.h"
+#include "TableParser.h"
+
+// Drives the engine through Spreadsheet.h, linked against libexcel.a: opens a table, applies a batch of
+// events, reads single values and a range, then saves the table and checks that the reloaded copy shows
+// the same values. Exits with 1 when a value is not the expected one:
+//   embed-example [--table FILE] [--config FILE]
+
+// - Parameters
+
+struct ExampleParameters {
+    std::string tableFileName = "build/embed-example.txt";
+    std::string configFileName = "config1.txt";
+};
+
+static ExampleParameters parseArguments(int argc, char* argv[]) {
+    ExampleParameters parameters;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string name = argv[i];
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for " + name);
+        }
+        std::string value = argv[++i];
+
+        if (name == "--table") parameters.tableFileName = value;
+        else if (name == "--config") parameters.configFileName = value;
+        else throw std::invalid_argument("Unknown option " + name);
+    }
+    return parameters;
+}
+
+// - Checks
+
+static size_t failures = 0;
+
+static void expect(const std::string& what, const std::string& actual, const std::string& expected) {
+    std::cout << what << ": '" << actual << "'";
+    if (actual != expected) {
+        std::cout << ", expected '" << expected << "'";
+        ++failures;
+    }
+    std::cout << "\n";
+}
+
+// - MAIN
+
+int main(int argc, char* argv[]) {
+    try {
+        ExampleParameters parameters = parseArguments(argc, argv);
+
+        // The table the example opens: three numbers in row A
+        TableModel start;
+        for (size_t column = 0; column < 3; ++column) {
+            start.setCellValue(CellAddress{ 0, column }, CellValue{ LiteralValue{ static_cast<double>(column + 1) } });
+        }
+        if (!TableParser::save(start, parameters.tableFileName)) {
+            throw std::runtime_error("Could not write '" + parameters.tableFileName + "'");
+        }
+
+        Spreadsheet spreadsheet(parameters.tableFileName, parameters.configFileName);
+
+        // One batch, recalculated once at the end. 'commit' without 'begin' fails and is skipped.
+        std::vector<Event> events;
+        for (const char* line : { "A4=SUM(A1:A3)", "B1=A4", "B2 insert \"total\"", "commit", "A1 insert 10" }) {
+            events.push_back(EventParser::parse(line));
+        }
+        Spreadsheet::BatchResult result = spreadsheet.apply(events);
+        expect("Applied events", std::to_string(result.applied), "4");
+        for (const auto& [index, message] : result.errors) {
+            std::cout << "  event " << index << " failed: " << message << "\n";
+        }
+        if (result.errors.size() != 1 || result.errors.front().first != 3) {
+            ++failures;
+        }
+
+        // Single values
+        expect("A4", spreadsheet.getValue(CellAddress::fromString("A4")), "15.000000");
+        std::vector<CellAddress> addresses = { CellAddress::fromString("B1"), CellAddress::fromString("B2"), CellAddress::fromString("C1") };
+        std::vector<std::string> values(addresses.size());
+        size_t found = spreadsheet.readValues(addresses.data(), addresses.size(), values.data());
+        expect("Non-empty of B1, B2, C1", std::to_string(found), "2");
+        expect("B1", values[0], "15.000000");
+        expect("B2", values[1], "total");
+
+        // A range, in row-major order
+        AddressRange range{ CellAddress::fromString("A1"), CellAddress::fromString("B4") };
+        std::vector<std::string> before(8);
+        spreadsheet.readRange(range, before.data());
+
+        // Saving and opening the file again gives the same values
+        spreadsheet.save(parameters.tableFileName);
+        Spreadsheet reloaded(parameters.tableFileName, parameters.configFileName);
+        std::vector<std::string> after(8);
+        reloaded.readRange(range, after.data());
+        for (size_t i = 0; i < before.size(); ++i) {
+            expect("Reloaded " + CellAddress{ i / 4, i % 4 }.toString(), after[i], before[i]);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Example failed: " << e.what() << std::endl;
+        return 2;
+    }
+
+    if (failures > 0) {
+        std::cout << failures << " unexpected values\n";
+        return 1;
+    }
+    std::cout << "All values as expected\n";
+    return 0;
+}
@@ -0,0 +1,379 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "CellAddress.h"
+#include "CellEvaluator.h"
+#include "EventParser.h"
+#include "TableConfiguration.h"
+#include "TableModel.h"
+#include "TableViewModel.h"
+
+// Runs random tables and edit streams through TableViewModel, with its lazy evaluation, incremental and
+// background recalculation and evaluation cache, and compares every display value with a full
+// recomputation of the same table by an uncached CellEvaluator. A failing case is minimized and written
+// as a batch script with its configuration:
+//   fuzz [--cases N] [--seed N] [--rows N] [--cols N] [--cells N] [--edits N] [--output FILE]
+
+// - Parameters
+
+struct FuzzParameters {
+    size_t cases = 200;
+    unsigned seed = 1;
+    size_t rows = 24;
+    size_t columns = 6;
+    size_t cells = 60;   // cells of the table the case opens
+    size_t edits = 60;   // commands applied to it
+    std::string outputFile = "fuzz-failure.txt";
+};
+
+static FuzzParameters parseArguments(int argc, char* argv[]) {
+    FuzzParameters parameters;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string name = argv[i];
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for " + name);
+        }
+        std::string value = argv[++i];
+
+        if (name == "--cases") parameters.cases = std::stoul(value);
+        else if (name == "--seed") parameters.seed = static_cast<unsigned>(std::stoul(value));
+        else if (name == "--rows") parameters.rows = std::stoul(value);
+        else if (name == "--cols") parameters.columns = std::stoul(value);
+        else if (name == "--cells") parameters.cells = std::stoul(value);
+        else if (name == "--edits") parameters.edits = std::stoul(value);
+        else if (name == "--output") parameters.outputFile = value;
+        else throw std::invalid_argument("Unknown option " + name);
+    }
+
+    if (parameters.rows < 2 || parameters.columns == 0) {
+        throw std::invalid_argument("rows must be at least 2 and cols positive");
+    }
+    return parameters;
+}
+
+// - Cases
+
+// Table cells and edits are kept as commands, so cases can be minimized line by line and replayed with --batch
+struct FuzzCase {
+    TableConfiguration config;
+    std::vector<std::string> cells;
+    std::vector<std::string> edits;
+};
+
+// Formulas and references only read rows above their own. Fill down shifts both by the same rows and
+// every other edit writes literals or restores earlier values, so no edit stream can build a cycle.
+class CaseGenerator {
+public:
+    CaseGenerator(const FuzzParameters& parameters, unsigned seed) : parameters(parameters), random(seed) {}
+
+    FuzzCase generate() {
+        FuzzCase fuzzCase;
+
+        // Small viewports and caches exercise lazy evaluation, scrolling and cache eviction
+        fuzzCase.config = TableConfiguration{ pick(2, 6), pick(2, 6), 30, 10, true, 15, Alignment::Left, false };
+        fuzzCase.config.calculationMode = chance(0.3) ? CalculationMode::Manual : CalculationMode::Automatic;
+        fuzzCase.config.recalcThreads = pick(1, 4);
+        fuzzCase.config.evaluationCacheSize = chance(0.3) ? 0 : pick(1, 50);
+        fuzzCase.config.recalcTimeBudgetMs = 1;
+
+        for (size_t i = 0; i < parameters.cells; ++i) {
+            fuzzCase.cells.push_back(cellCommand(randomCell()));
+        }
+        for (size_t i = 0; i < parameters.edits; ++i) {
+            fuzzCase.edits.push_back(editCommand());
+        }
+        return fuzzCase;
+    }
+
+private:
+    const FuzzParameters& parameters;
+    std::mt19937 random;
+
+    int pick(int low, int high) {
+        return std::uniform_int_distribution<int>(low, high)(random);
+    }
+
+    bool chance(double probability) {
+        return std::uniform_real_distribution<double>(0.0, 1.0)(random) < probability;
+    }
+
+    CellAddress randomCell() {
+        return CellAddress{ static_cast<size_t>(pick(0, static_cast<int>(parameters.rows) - 1)), static_cast<size_t>(pick(0, static_cast<int>(parameters.columns) - 1)) };
+    }
+
+    // A cell in a row above row
+    CellAddress cellAbove(size_t row) {
+        return CellAddress{ static_cast<size_t>(pick(0, static_cast<int>(row) - 1)), static_cast<size_t>(pick(0, static_cast<int>(parameters.columns) - 1)) };
+    }
+
+    std::string rangeAbove(size_t row) {
+        CellAddress first = cellAbove(row);
+        CellAddress last = cellAbove(row);
+        return first.toString() + ":" + last.toString();
+    }
+
+    std::string literal() {
+        switch (pick(0, 5)) {
+        case 0: return std::to_string(pick(-50, 50));
+        case 1: return std::to_string(pick(0, 99)) + ".5";
+        case 2: return chance(0.5) ? "TRUE" : "FALSE";
+        case 3: return "\"\"";
+        default: return "\"t" + std::to_string(pick(0, 20)) + "\"";
+        }
+    }
+
+    std::string formula(size_t row) {
+        static const char* rangeFormulas[] = { "SUM", "AVERAGE", "MIN", "MAX", "COUNT" };
+
+        switch (pick(0, 5)) {
+        case 0: return std::string(rangeFormulas[pick(0, 4)]) + "(" + rangeAbove(row) + ")";
+        case 1: return "SUM(" + cellAbove(row).toString() + "," + rangeAbove(row) + "," + std::to_string(pick(0, 9)) + ")";
+        case 2: return "CONCAT(" + rangeAbove(row) + ",-)";
+        case 3: return "LEN(" + cellAbove(row).toString() + ")";
+        case 4: return "SUBSTR(" + cellAbove(row).toString() + "," + std::to_string(pick(0, 3)) + "," + std::to_string(pick(0, 3)) + ")";
+        default: return std::string(rangeFormulas[pick(0, 4)]) + "(" + cellAbove(row).toString() + ")";
+        }
+    }
+
+    std::string cellCommand(const CellAddress& address) {
+        std::string target = address.toString();
+        if (address.row > 0 && chance(0.5)) {
+            return chance(0.3) ? target + "=" + cellAbove(address.row).toString() : target + "=" + formula(address.row);
+        }
+        return target + " insert " + literal();
+    }
+
+    std::string editCommand() {
+        int kind = pick(0, 99);
+        if (kind < 40) {
+            return cellCommand(randomCell());
+        }
+        if (kind < 50) {
+            return randomCell().toString() + " delete";
+        }
+        if (kind < 55) {
+            CellAddress first = randomCell();
+            CellAddress last{ std::min(first.row + pick(0, 3), parameters.rows - 1), std::min(first.column + pick(0, 2), parameters.columns - 1) };
+            return first.toString() + ":" + last.toString() + " fill " + literal();
+        }
+        if (kind < 62) {
+            CellAddress first = randomCell();
+            CellAddress last{ std::min(first.row + pick(1, 4), parameters.rows - 1), std::min(first.column + pick(0, 2), parameters.columns - 1) };
+            return first.toString() + ":" + last.toString() + " filldown";
+        }
+        if (kind < 66) {
+            return randomCell().toString() + " paste " + literal() + "," + literal() + ";," + literal();
+        }
+        if (kind < 72) return "undo";
+        if (kind < 76) return "redo";
+        if (kind < 80) return "begin";
+        if (kind < 84) return "commit";
+        if (kind < 86) return "rollback";
+        if (kind < 90) return "calc";
+        if (kind < 95) return "goto " + randomCell().toString();
+        return std::string("scroll ") + (chance(0.5) ? "down" : "up") + " " + std::to_string(pick(1, 5));
+    }
+};
+
+// - Engines
+
+// Table the case opens, built like a loaded table file
+static TableModel buildTable(const std::vector<std::string>& cells) {
+    TableModel table;
+    for (const std::string& command : cells) {
+        Event event = EventParser::parse(command);
+        if (auto insert = std::get_if<InsertEvent>(&event)) {
+            table.setCellValue(insert->target, CellValue{ insert->value });
+        }
+        else if (auto reference = std::get_if<ReferenceEvent>(&event)) {
+            table.setCellValue(reference->target, reference->sheet
+                ? CellValue{ SheetAddress{ *reference->sheet, reference->source } } : CellValue{ reference->source });
+        }
+        else if (auto formula = std::get_if<FormulaEvent>(&event)) {
+            table.setCellValue(formula->target, CellValue{ FormulaValue{ formula->formula, formula->params } });
+        }
+    }
+    return table;
+}
+
+// Display values must match a full recomputation. Cells without a display value are only allowed while
+// they are still pending, which complete comparisons rule out by evaluating them first.
+static std::optional<std::string> compare(TableViewModel& viewModel, bool complete) {
+    if (complete) {
+        viewModel.evaluatePendingCells();
+    }
+
+    const TableModel& table = viewModel.getTableModel();
+    const DisplayableTableModel& display = viewModel.getDisplayableTableModel();
+    CellEvaluator reference(table);
+
+    for (const auto& [address, value] : table.getAllCells()) {
+        const std::string* shown = display.getDisplayValue(address);
+        if (!shown) {
+            if (complete) {
+                return address.toString() + " has no display value";
+            }
+            continue;
+        }
+        std::string expected = reference.evaluate(value);
+        if (*shown != expected) {
+            return address.toString() + " shows '" + *shown + "', expected '" + expected + "'";
+        }
+    }
+
+    for (const auto& [address, shown] : display.getAllDisplayValues()) {
+        if (!table.getCellValue(address)) {
+            return address.toString() + " shows '" + shown + "' but the cell is empty";
+        }
+    }
+    return std::nullopt;
+}
+
+// Returns the first mismatch, after the edit that caused it
+static std::optional<std::string> runCase(const FuzzCase& fuzzCase) {
+    TableViewModel viewModel(fuzzCase.config, buildTable(fuzzCase.cells));
+    bool automatic = fuzzCase.config.calculationMode == CalculationMode::Automatic;
+
+    if (auto mismatch = compare(viewModel, false)) {
+        return "after opening the table: " + *mismatch;
+    }
+
+    for (size_t i = 0; i < fuzzCase.edits.size(); ++i) {
+        const std::string& command = fuzzCase.edits[i];
+        try {
+            viewModel.handle(EventParser::parse(command));
+        }
+        catch (const std::exception&) {
+            // Undo with nothing to undo, commit without begin and the like leave the table as it was
+        }
+        viewModel.waitForRecalculation();
+
+        if ((automatic || command == "calc") && !viewModel.isInTransaction()) {
+            if (auto mismatch = compare(viewModel, false)) {
+                return "after '" + command + "' (edit " + std::to_string(i + 1) + "): " + *mismatch;
+            }
+        }
+    }
+
+    if (viewModel.isInTransaction()) {
+        viewModel.commitTransaction();
+    }
+    viewModel.handle(CalculateEvent{});
+    viewModel.waitForRecalculation();
+    if (auto mismatch = compare(viewModel, true)) {
+        return "at the end: " + *mismatch;
+    }
+    return std::nullopt;
+}
+
+// - Minimization
+
+// Drops chunks of lines, halving the chunk size down to single lines, as long as the case keeps failing
+static void minimizeLines(FuzzCase& fuzzCase, std::vector<std::string> FuzzCase::* lines) {
+    for (size_t chunk = std::max<size_t>((fuzzCase.*lines).size() / 2, 1); chunk > 0; chunk /= 2) {
+        for (size_t start = 0; start < (fuzzCase.*lines).size();) {
+            FuzzCase candidate = fuzzCase;
+            auto& candidateLines = candidate.*lines;
+            candidateLines.erase(candidateLines.begin() + start, candidateLines.begin() + std::min(start + chunk, candidateLines.size()));
+
+            if (runCase(candidate)) {
+                fuzzCase = std::move(candidate);
+            }
+            else {
+                start += chunk;
+            }
+        }
+    }
+}
+
+static void minimize(FuzzCase& fuzzCase) {
+    size_t size;
+    do {
+        size = fuzzCase.cells.size() + fuzzCase.edits.size();
+        minimizeLines(fuzzCase, &FuzzCase::edits);
+        minimizeLines(fuzzCase, &FuzzCase::cells);
+    } while (fuzzCase.cells.size() + fuzzCase.edits.size() < size);
+
+    // Simpler settings make the failure easier to follow, when they still reproduce it
+    for (auto simplify : { +[](TableConfiguration& config) { config.recalcThreads = 1; },
+                           +[](TableConfiguration& config) { config.evaluationCacheSize = 0; },
+                           +[](TableConfiguration& config) { config.calculationMode = CalculationMode::Automatic; } }) {
+        FuzzCase candidate = fuzzCase;
+        simplify(candidate.config);
+        if (runCase(candidate)) {
+            fuzzCase = std::move(candidate);
+        }
+    }
+}
+
+// - Output
+
+static void writeFailure(const FuzzCase& fuzzCase, const std::string& fileName) {
+    std::string configFileName = fileName + ".config";
+    std::ofstream config(configFileName);
+    const TableConfiguration& c = fuzzCase.config;
+    config << "initialTableRows:" << c.initialTableRows << "\n"
+        << "initialTableCols:" << c.initialTableCols << "\n"
+        << "maxTableRows:" << c.maxTableRows << "\n"
+        << "maxTableCols:" << c.maxTableCols << "\n"
+        << "autoFit:true\n"
+        << "visibleCellSymbols:" << c.visibleCellSymbols << "\n"
+        << "initialAlignment:left\n"
+        << "clearConsoleAfterCommand:false\n"
+        << "calculationMode:" << (c.calculationMode == CalculationMode::Manual ? "manual" : "automatic") << "\n"
+        << "recalcThreads:" << c.recalcThreads << "\n"
+        << "evaluationCacheSize:" << c.evaluationCacheSize << "\n"
+        << "recalcTimeBudgetMs:" << c.recalcTimeBudgetMs << "\n";
+
+    // Opening the table is replaced by typing its cells, the lazy evaluation of opened tables is not replayed
+    std::ofstream script(fileName);
+    script << "new " << configFileName << "\n";
+    for (const std::string& line : fuzzCase.cells) script << line << "\n";
+    for (const std::string& line : fuzzCase.edits) script << line << "\n";
+
+    if (!config || !script) {
+        throw std::runtime_error("Could not write " + fileName);
+    }
+}
+
+// - MAIN
+
+int main(int argc, char* argv[]) {
+    try {
+        FuzzParameters parameters = parseArguments(argc, argv);
+
+        for (size_t i = 0; i < parameters.cases; ++i) {
+            unsigned seed = parameters.seed + static_cast<unsigned>(i);
+            FuzzCase fuzzCase = CaseGenerator(parameters, seed).generate();
+
+            std::optional<std::string> mismatch = runCase(fuzzCase);
+            if (!mismatch) {
+                continue;
+            }
+
+            std::cout << "Case " << seed << " failed " << *mismatch << "\n";
+            minimize(fuzzCase);
+            std::cout << "Minimized to " << fuzzCase.cells.size() << " cells and " << fuzzCase.edits.size() << " edits, failing "
+                << runCase(fuzzCase).value_or("no more (the failure is intermittent)") << "\n";
+
+            writeFailure(fuzzCase, parameters.outputFile);
+            std::cout << "Written to '" << parameters.outputFile << "', replay with: excel --batch " << parameters.outputFile << "\n";
+            return 1;
+        }
+
+        std::cout << "All " << parameters.cases << " cases match\n";
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Fuzzing failed: " << e.what() << std::endl;
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,266 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "EventParser.h"
+#include "RegexEventParser.h"
+
+// Parses random command lines with EventParser and with the regex cascade it replaced, and reports the
+// first line on which they produce different events or only one of them throws. Lines are built from the
+// commands the regex parser knew, then mutated character by character. The micro-benchmark times both
+// parsers on typical script lines:
+//   parser-fuzz [--lines N] [--seed N] [--bench-lines N]
+
+// - Parameters
+
+struct ParserFuzzParameters {
+    size_t lines = 200000;
+    unsigned seed = 1;
+    size_t benchLines = 200000;
+};
+
+static ParserFuzzParameters parseArguments(int argc, char* argv[]) {
+    ParserFuzzParameters parameters;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string name = argv[i];
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for " + name);
+        }
+        std::string value = argv[++i];
+
+        if (name == "--lines") parameters.lines = std::stoul(value);
+        else if (name == "--seed") parameters.seed = static_cast<unsigned>(std::stoul(value));
+        else if (name == "--bench-lines") parameters.benchLines = std::stoul(value);
+        else throw std::invalid_argument("Unknown option " + name);
+    }
+    return parameters;
+}
+
+// - Lines
+
+// Commands added after the regex parser ('sheet', 'fill', qualified Name!A1 references, ...) are never
+// generated: the mutation alphabet has no '!' and no keyword can be spelled by single-character edits.
+class LineGenerator {
+public:
+    explicit LineGenerator(unsigned seed) : random(seed) {}
+
+    std::string generate() {
+        std::string line = command();
+        size_t mutations = chance(0.5) ? 0 : pick(1, 3);
+        for (size_t i = 0; i < mutations; ++i) {
+            mutate(line);
+        }
+        return line;
+    }
+
+private:
+    std::mt19937 random;
+
+    size_t pick(size_t low, size_t high) {
+        return std::uniform_int_distribution<size_t>(low, high)(random);
+    }
+
+    bool chance(double probability) {
+        return std::bernoulli_distribution(probability)(random);
+    }
+
+    template <typename T>
+    const T& oneOf(const std::vector<T>& values) {
+        return values[pick(0, values.size() - 1)];
+    }
+
+    std::string cell() {
+        static const std::vector<std::string> odd = { "A0", "a1", "AA", "1", "ZZ99", "AB12", "A01", "Z999999" };
+        if (chance(0.1)) return oneOf(odd);
+        std::string row(1, static_cast<char>('A' + pick(0, 25)));
+        if (chance(0.2)) row += static_cast<char>('A' + pick(0, 25));
+        return row + std::to_string(pick(1, 30));
+    }
+
+    std::string value() {
+        static const std::vector<std::string> values = {
+            "0", "42", "-1", "3.25", "-0.5", "1.", ".5", "1e5", "--1", "TRUE", "FALSE", "true",
+            "\"abc\"", "\"a b\"", "\"\"", "\"x1\"", "abc", "\"unterminated", "#VALUE!"
+        };
+        return oneOf(values);
+    }
+
+    std::string param() {
+        switch (pick(0, 5)) {
+        case 0: return cell();
+        case 1: return cell() + ":" + cell();
+        case 2: return value();
+        case 3: return " " + cell() + " ";
+        case 4: return "";
+        default: return cell() + ":";
+        }
+    }
+
+    std::string formula() {
+        static const std::vector<std::string> names = {
+            "SUM", "AVERAGE", "MIN", "MAX", "CONCAT", "SUBSTR", "LEN", "COUNT", "sum", "FOO", ""
+        };
+        std::string params;
+        size_t count = pick(0, 4);
+        for (size_t i = 0; i < count; ++i) {
+            params += (i > 0 ? "," : "") + param();
+        }
+        if (chance(0.1)) params += ",";
+        return oneOf(names) + "(" + params + ")";
+    }
+
+    std::string command() {
+        static const std::vector<std::string> files = { "table.txt", "a b.txt", "config1.txt", "x", "" };
+        switch (pick(0, 9)) {
+        case 0: return "open " + oneOf(files) + " " + oneOf(files);
+        case 1: return "new " + oneOf(files);
+        case 2: return "import " + oneOf(files);
+        case 3: return "export " + oneOf(files) + (chance(0.5) ? std::string(" ") + (chance(0.5) ? "values" : "raw") : "");
+        case 4: return cell() + " delete";
+        case 5: return cell() + "=" + cell();
+        case 6:
+        case 7: return cell() + " insert " + value();
+        default: return cell() + "=" + formula();
+        }
+    }
+
+    void mutate(std::string& line) {
+        static const std::string alphabet = " \tAZaz019=():,.-\"_#";
+        char c = alphabet[pick(0, alphabet.size() - 1)];
+        size_t position = pick(0, line.size());
+        switch (pick(0, 2)) {
+        case 0:
+            line.insert(position, 1, c);
+            break;
+        case 1:
+            if (position < line.size()) line.erase(position, 1);
+            break;
+        default:
+            if (position < line.size()) line[position] = c;
+            break;
+        }
+    }
+};
+
+// - Comparison
+
+static std::string describe(const LiteralValue& literal) {
+    if (auto val = std::get_if<double>(&literal.value)) {
+        char number[32];
+        std::snprintf(number, sizeof(number), "%.17g", *val);
+        return std::string("number ") + number;
+    }
+    if (auto val = std::get_if<bool>(&literal.value)) {
+        return *val ? "TRUE" : "FALSE";
+    }
+    return "text '" + std::get<std::string>(literal.value) + "'";
+}
+
+static std::string describe(const FormulaParam& param) {
+    if (auto val = std::get_if<LiteralValue>(&param)) return describe(*val);
+    if (auto val = std::get_if<CellAddress>(&param)) return "cell " + val->toString();
+    if (auto val = std::get_if<AddressRange>(&param)) return "range " + val->start.toString() + ":" + val->end.toString();
+    if (auto val = std::get_if<SheetAddress>(&param)) return "cell " + val->sheet + "!" + val->address.toString();
+    const SheetRange& range = std::get<SheetRange>(param);
+    return "range " + range.sheet + "!" + range.range.start.toString() + ":" + range.range.end.toString();
+}
+
+// Canonical text of an event, equal for equal events
+static std::string describe(const Event& event) {
+    if (auto e = std::get_if<OpenTableEvent>(&event)) return "open '" + e->tableName + "' '" + e->configFileName + "'";
+    if (auto e = std::get_if<NewTableEvent>(&event)) return "new '" + e->configFileName + "'";
+    if (auto e = std::get_if<ImportEvent>(&event)) return "import '" + e->fileName + "'";
+    if (auto e = std::get_if<ExportEvent>(&event)) return "export '" + e->fileName + "' " + (e->evaluated ? "values" : "raw");
+    if (auto e = std::get_if<InsertEvent>(&event)) return "insert " + e->target.toString() + " " + describe(e->value);
+    if (auto e = std::get_if<DeleteEvent>(&event)) return "delete " + e->target.toString();
+    if (auto e = std::get_if<ReferenceEvent>(&event)) {
+        return "reference " + e->target.toString() + " " + (e->sheet ? *e->sheet + "!" : "") + e->source.toString();
+    }
+    if (auto e = std::get_if<FormulaEvent>(&event)) {
+        std::string text = "formula " + e->target.toString() + " " + std::to_string(static_cast<int>(e->formula));
+        for (const auto& param : e->params) {
+            text += ", " + describe(param);
+        }
+        return text;
+    }
+    return "event #" + std::to_string(event.index());
+}
+
+template <typename Parse>
+static std::string parseToText(Parse parse, const std::string& line) {
+    try {
+        return describe(parse(line));
+    }
+    catch (const std::exception&) {
+        return "error";
+    }
+}
+
+// - Benchmark
+
+template <typename Parse>
+static double nanosecondsPerLine(Parse parse, const std::vector<std::string>& lines, size_t count) {
+    size_t parsed = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        Event event = parse(lines[i % lines.size()]);
+        parsed += event.index();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+    // Keeps the parses from being optimized away
+    if (parsed == static_cast<size_t>(-1)) std::cout << "";
+    return count > 0 ? elapsed.count() / count : 0;
+}
+
+static void runBenchmark(size_t count) {
+    const std::vector<std::string> lines = {
+        "A1 insert 42", "B12 insert \"label\"", "C3 insert TRUE", "AB7 insert -3.75", "D4=A1",
+        "E5=SUM(A1:A100)", "F6=CONCAT(A1:C1,\"-\")", "G7=SUBSTR(B2,1,3)", "H8 delete", "export out.csv raw"
+    };
+
+    auto hand = [](const std::string& line) { return EventParser::parse(line); };
+    auto regex = [](const std::string& line) { return RegexEventParser::parse(line); };
+    double handNs = nanosecondsPerLine(hand, lines, count);
+    double regexNs = nanosecondsPerLine(regex, lines, count);
+
+    std::cout << "EventParser:      " << handNs << " ns/line\n";
+    std::cout << "RegexEventParser: " << regexNs << " ns/line (" << (handNs > 0 ? regexNs / handNs : 0) << "x)\n";
+}
+
+// - MAIN
+
+int main(int argc, char* argv[]) {
+    try {
+        ParserFuzzParameters parameters = parseArguments(argc, argv);
+        LineGenerator generator(parameters.seed);
+
+        auto hand = [](const std::string& line) { return EventParser::parse(line); };
+        auto regex = [](const std::string& line) { return RegexEventParser::parse(line); };
+
+        for (size_t i = 0; i < parameters.lines; ++i) {
+            std::string line = generator.generate();
+            std::string expected = parseToText(regex, line);
+            std::string actual = parseToText(hand, line);
+            if (actual != expected) {
+                std::cout << "Line " << i + 1 << " differs: '" << line << "'\n"
+                    << "  EventParser:      " << actual << "\n"
+                    << "  RegexEventParser: " << expected << "\n";
+                return 1;
+            }
+        }
+        std::cout << "All " << parameters.lines << " lines match\n";
+
+        runBenchmark(parameters.benchLines);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Parser fuzzing failed: " << e.what() << std::endl;
+        return 2;
+    }
+    return 0;
+}
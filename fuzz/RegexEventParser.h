@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+#include "Event.h"
+
+// The std::regex cascade EventParser used before its hand-written parser, kept as the reference the
+// parser fuzzer compares against. Covers the commands it knew: open, new, import, export, insert,
+// delete, references and formulas.
+class RegexEventParser {
+public:
+    static Event parse(const std::string& input);
+};
@@ -0,0 +1,519 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "CellAddress.h"
+#include "EditHistory.h"
+#include "EventParser.h"
+#include "Spreadsheet.h"
+#include "TableConfiguration.h"
+#include "TableModel.h"
+#include "TableParser.h"
+#include "TableSnapshotParser.h"
+
+// Round trips and error paths of the file formats and the editing commands, each test on its own table.
+// Files are written to the scratch directory; the exit code is the number of failed tests:
+//   engine-tests [--scratch DIR]
+
+// - Checks
+
+struct TestFailure : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+static void check(bool condition, const std::string& message) {
+    if (!condition) {
+        throw TestFailure(message);
+    }
+}
+
+static void checkEqual(const std::string& actual, const std::string& expected, const std::string& what) {
+    check(actual == expected, what + " is '" + actual + "', expected '" + expected + "'");
+}
+
+// Passes when the call throws anything but a TestFailure
+static void checkThrows(const std::function<void()>& call, const std::string& what) {
+    try {
+        call();
+    }
+    catch (const TestFailure&) {
+        throw;
+    }
+    catch (const std::exception&) {
+        return;
+    }
+    throw TestFailure(what + " did not fail");
+}
+
+// - Helpers
+
+static std::string scratchDirectory = "build";
+
+static std::string scratchFile(const std::string& name) {
+    return scratchDirectory + "/" + name;
+}
+
+static void writeFile(const std::string& fileName, const std::string& content) {
+    std::ofstream file(fileName, std::ios::binary);
+    file << content;
+    if (!file) {
+        throw std::runtime_error("Could not write '" + fileName + "'");
+    }
+}
+
+static std::string readFile(const std::string& fileName) {
+    std::ifstream file(fileName, std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+static TableConfiguration testConfiguration() {
+    return TableConfiguration{ 10, 10, 100, 100, true, 15, Alignment::Left, false };
+}
+
+static CellAddress cell(const std::string& address) {
+    return CellAddress::fromString(address);
+}
+
+// Applies the commands as one batch and fails on the first command that fails
+static void run(Spreadsheet& spreadsheet, const std::vector<std::string>& commands) {
+    std::vector<Event> events;
+    for (const auto& command : commands) {
+        events.push_back(EventParser::parse(command));
+    }
+    Spreadsheet::BatchResult result = spreadsheet.apply(events);
+    check(result.errors.empty(), result.errors.empty() ? "" :
+        "'" + commands[result.errors.front().first] + "' failed: " + result.errors.front().second);
+}
+
+// Error message of the single command, empty when it succeeds
+static std::string runFailing(Spreadsheet& spreadsheet, const std::string& command) {
+    Spreadsheet::BatchResult result = spreadsheet.apply({ EventParser::parse(command) });
+    return result.errors.empty() ? std::string() : result.errors.front().second;
+}
+
+static std::string describe(const LiteralValue& literal) {
+    if (auto val = std::get_if<double>(&literal.value)) {
+        char number[32];
+        std::snprintf(number, sizeof(number), "%.17g", *val);
+        return std::string("number ") + number;
+    }
+    if (auto val = std::get_if<bool>(&literal.value)) {
+        return *val ? "TRUE" : "FALSE";
+    }
+    return "text '" + std::get<std::string>(literal.value) + "'";
+}
+
+static std::string describe(const FormulaParam& param) {
+    if (auto val = std::get_if<LiteralValue>(&param)) return describe(*val);
+    if (auto val = std::get_if<CellAddress>(&param)) return val->toString();
+    if (auto val = std::get_if<AddressRange>(&param)) return val->start.toString() + ":" + val->end.toString();
+    if (auto val = std::get_if<SheetAddress>(&param)) return val->sheet + "!" + val->address.toString();
+    const SheetRange& range = std::get<SheetRange>(param);
+    return range.sheet + "!" + range.range.start.toString() + ":" + range.range.end.toString();
+}
+
+static std::string describe(const CellValue& value) {
+    if (auto val = std::get_if<LiteralValue>(&value.value)) return describe(*val);
+    if (auto val = std::get_if<CellAddress>(&value.value)) return "=" + val->toString();
+    if (auto val = std::get_if<SheetAddress>(&value.value)) return "=" + val->sheet + "!" + val->address.toString();
+
+    const FormulaValue& formula = std::get<FormulaValue>(value.value);
+    std::string text = "=" + std::to_string(static_cast<int>(formula.type)) + "(";
+    for (size_t i = 0; i < formula.parameters.size(); ++i) {
+        text += (i > 0 ? ", " : "") + describe(formula.parameters[i]);
+    }
+    return text + ")";
+}
+
+// Canonical text of every cell, equal for equal tables
+static std::string describe(const TableModel& table) {
+    std::vector<std::string> lines;
+    for (const auto& [address, value] : table.getAllCells()) {
+        lines.push_back(address.toString() + " " + describe(value));
+    }
+    std::sort(lines.begin(), lines.end());
+
+    std::string text;
+    for (const auto& line : lines) {
+        text += line + "\n";
+    }
+    return text;
+}
+
+// - CSV
+
+static void testCsvQuotedFieldsAreText() {
+    std::string fileName = scratchFile("quoted.csv");
+    writeFile(fileName, "\"0123\",0123,\"a,b\",\"say \"\"hi\"\"\"\n\"'=A1\",=A1,\"TRUE\",TRUE,\"=SUM(A1,A2)\"\n");
+
+    TableModel table;
+    size_t imported = TableParser::importCsv(table, fileName);
+    checkEqual(std::to_string(imported), "9", "Imported cell count");
+    checkEqual(describe(*table.getCellValue(cell("A1"))), "text '0123'", "Quoted digits");
+    checkEqual(describe(*table.getCellValue(cell("A2"))), "number 123", "Unquoted digits");
+    checkEqual(describe(*table.getCellValue(cell("A3"))), "text 'a,b'", "Quoted comma");
+    checkEqual(describe(*table.getCellValue(cell("A4"))), "text 'say \"hi\"'", "Escaped quotes");
+    checkEqual(describe(*table.getCellValue(cell("B1"))), "text '=A1'", "Text marked by an apostrophe");
+    checkEqual(describe(*table.getCellValue(cell("B2"))), "=A1", "Unquoted reference");
+    checkEqual(describe(*table.getCellValue(cell("B3"))), "text 'TRUE'", "Quoted boolean");
+    checkEqual(describe(*table.getCellValue(cell("B4"))), "TRUE", "Unquoted boolean");
+    checkEqual(describe(*table.getCellValue(cell("B5"))), "=0(A1, A2)", "Quoted formula");
+}
+
+static void testCsvRawExportRoundTrip() {
+    Spreadsheet original(testConfiguration());
+    run(original, {
+        "A1 insert 1.5", "A2 insert -2", "A3 insert TRUE", "B1 insert \"0123\"", "B2 insert \"abc\"",
+        "C1=A1", "C2=SUM(A1:A2)", "C3=CONCAT(B2,\"x\")", "C4=MAX(A1,A2,1)"
+    });
+    std::string fileName = scratchFile("raw.csv");
+    run(original, { "export " + fileName + " raw" });
+
+    Spreadsheet imported(testConfiguration());
+    run(imported, { "import " + fileName });
+    checkEqual(describe(imported.getTableModel()), describe(original.getTableModel()), "Imported raw export");
+    checkEqual(imported.getValue(cell("C2")), "-0.500000", "Imported formula value");
+}
+
+static void testCsvValuesExport() {
+    // Text with a comma can't be typed as a command, it comes from the imported file
+    std::string input = scratchFile("values-input.csv");
+    writeFile(input, "2,3\n=SUM(A1:A2),\"a,b\"\n");
+
+    Spreadsheet spreadsheet(testConfiguration());
+    std::string fileName = scratchFile("values.csv");
+    run(spreadsheet, { "import " + input, "export " + fileName + " values" });
+    checkEqual(readFile(fileName), "2.000000,3.000000\n5.000000,\"a,b\"\n", "Exported values");
+}
+
+static void testCsvImportErrors() {
+    std::string missing = scratchFile("missing.csv");
+    std::remove(missing.c_str());
+    checkThrows([&] { TableModel table; TableParser::importCsv(table, missing); }, "Importing a missing file");
+
+    Spreadsheet spreadsheet(testConfiguration());
+    check(!runFailing(spreadsheet, "import " + missing).empty(), "The import command did not report the missing file");
+
+    std::string fileName = scratchFile("transaction.csv");
+    writeFile(fileName, "1,2\n");
+    run(spreadsheet, { "begin" });
+    check(!runFailing(spreadsheet, "import " + fileName).empty(), "Importing inside a transaction did not fail");
+    run(spreadsheet, { "rollback" });
+}
+
+static void testCsvImportClearsUndo() {
+    Spreadsheet spreadsheet(testConfiguration());
+    run(spreadsheet, { "A1 insert 1" });
+    std::string fileName = scratchFile("undo.csv");
+    writeFile(fileName, "5,6\n");
+    run(spreadsheet, { "import " + fileName });
+
+    checkEqual(spreadsheet.getViewModel().takeUndoNote(), "Imports can't be undone, the undo history was cleared.", "Undo note");
+    check(!runFailing(spreadsheet, "undo").empty(), "Undo after an import did not fail");
+    checkEqual(spreadsheet.getValue(cell("A1")), "5.000000", "Imported value after undo");
+}
+
+// - Table files
+
+// 40 rows of numbers, each row summed with the one before it and referenced, plus formulas written once
+static TableModel filledTable() {
+    TableModel table;
+    for (size_t row = 0; row < 40; ++row) {
+        table.setCellValue(CellAddress{ row, 0 }, CellValue{ LiteralValue{ static_cast<double>(row) } });
+        table.setCellValue(CellAddress{ row, 2 }, CellValue{ CellAddress{ row, 0 } });
+        if (row > 0) {
+            table.setCellValue(CellAddress{ row, 1 }, CellValue{ FormulaValue{ FormulaType::SUM, {
+                AddressRange{ CellAddress{ row - 1, 0 }, CellAddress{ row, 0 } }, LiteralValue{ 1.0 } } } });
+        }
+    }
+    table.setCellValue(cell("A5"), CellValue{ FormulaValue{ FormulaType::MAX, { cell("A1"), SheetAddress{ "Other", cell("B2") } } } });
+    table.setCellValue(cell("A6"), CellValue{ LiteralValue{ std::string("text") } });
+    return table;
+}
+
+static void testSharedFormulaRoundTrip() {
+    TableModel table = filledTable();
+    std::string fileName = scratchFile("shared.txt");
+    check(TableParser::save(table, fileName), "Saving the table failed");
+
+    // The 39 filled formulas are one line, the formula written once another
+    std::istringstream content(readFile(fileName));
+    size_t formulaLines = 0;
+    std::string line;
+    while (std::getline(content, line)) {
+        formulaLines += line.find("=shared:") != std::string::npos || line.find("=formula:") != std::string::npos;
+    }
+    checkEqual(std::to_string(formulaLines), "2", "Formula lines");
+
+    checkEqual(describe(TableParser::load(fileName)), describe(table), "Loaded table");
+}
+
+static void testTableFileErrors() {
+    // Lines of earlier versions load as before, broken lines are skipped
+    std::string fileName = scratchFile("broken.txt");
+    writeFile(fileName, "A1=number:2.000000\nA2=formula:SUM(cell:A1,literal:number:1.000000)\n"
+        "A3=shared:SUM(nonsense)\nA4=number:oops\nnot a line\nA5=reference:A1\n");
+    TableModel table = TableParser::load(fileName);
+    checkEqual(describe(table), "A1 number 2\nA2 =0(A1, number 1)\nA5 =A1\n", "Loaded cells");
+
+    std::string missing = scratchFile("missing.txt");
+    std::remove(missing.c_str());
+    checkThrows([&] { TableParser::load(missing); }, "Loading a missing table");
+}
+
+// - Snapshots
+
+static void testSnapshotRoundTrip() {
+    TableModel table = filledTable();
+    table.setCellValue(cell("B1"), CellValue{ LiteralValue{ true } });
+    table.setCellValue(cell("C1"), CellValue{ LiteralValue{ false } });
+    table.setCellValue(cell("D1"), CellValue{ LiteralValue{ 0.1 } });
+    table.setCellValue(cell("E1"), CellValue{ LiteralValue{ -1e300 } });
+    table.setCellValue(cell("F1"), CellValue{ LiteralValue{ std::string("text") } });
+    table.setCellValue(cell("G1"), CellValue{ SheetAddress{ "Other", cell("A1") } });
+
+    std::string fileName = scratchFile("table.xlsnap");
+    check(TableParser::save(table, fileName), "Saving the snapshot failed");
+    check(TableSnapshotParser::isSnapshotFile(fileName), "The snapshot is not recognized");
+    checkEqual(describe(TableParser::load(fileName)), describe(table), "Loaded snapshot");
+}
+
+// Every truncation of a valid snapshot is rejected, every flipped byte is rejected or still loads
+static void testSnapshotCorruptInput() {
+    std::string valid = scratchFile("valid.xlsnap");
+    check(TableParser::save(filledTable(), valid), "Saving the snapshot failed");
+    std::string data = readFile(valid);
+
+    std::string fileName = scratchFile("corrupt.xlsnap");
+    for (size_t size = 0; size < data.size(); ++size) {
+        writeFile(fileName, data.substr(0, size));
+        checkThrows([&] { TableSnapshotParser::load(fileName); }, "Loading the first " + std::to_string(size) + " bytes");
+    }
+
+    for (size_t i = 0; i < data.size(); ++i) {
+        std::string corrupt = data;
+        corrupt[i] = static_cast<char>(corrupt[i] ^ 0xFF);
+        writeFile(fileName, corrupt);
+        try {
+            TableSnapshotParser::load(fileName);
+        }
+        catch (const std::exception&) {
+        }
+    }
+
+    // A count larger than the file is rejected before anything is allocated
+    std::string huge = data.substr(0, 8) + std::string("\xff\xff\xff\xff\xff\xff\xff\xff\x7f", 9) + data.substr(9);
+    writeFile(fileName, huge);
+    checkThrows([&] { TableSnapshotParser::load(fileName); }, "Loading a snapshot with a huge count");
+}
+
+// - Editing commands
+
+static void testFillAndPaste() {
+    Spreadsheet spreadsheet(testConfiguration());
+    run(spreadsheet, { "A1:B2 fill 7", "C1 paste 1,2;3,4", "E1 insert 10", "E2=SUM(E1:E1)", "E1:G2 filldown" });
+
+    std::vector<std::string> values(4);
+    spreadsheet.readRange(AddressRange{ cell("A1"), cell("B2") }, values.data());
+    for (const auto& value : values) {
+        checkEqual(value, "7.000000", "Filled value");
+    }
+    checkEqual(spreadsheet.getValue(cell("C2")), "2.000000", "Pasted C2");
+    checkEqual(spreadsheet.getValue(cell("D1")), "3.000000", "Pasted D1");
+
+    // Filled down rows keep their relative references
+    checkEqual(spreadsheet.getValue(cell("G1")), "10.000000", "Filled down G1");
+    run(spreadsheet, { "F1 insert 5" });
+    checkEqual(spreadsheet.getValue(cell("F2")), "5.000000", "Filled down formula after an edit");
+    checkEqual(spreadsheet.getValue(cell("G2")), "10.000000", "Filled down formula of another row");
+    checkEqual(describe(*spreadsheet.getTableModel().getCellValue(cell("G2"))), "=0(G1:G1)", "Filled down formula");
+}
+
+static void testTransactions() {
+    Spreadsheet spreadsheet(testConfiguration());
+    run(spreadsheet, { "A1 insert 1", "A2 insert 2", "A3=SUM(A1:A2)" });
+
+    run(spreadsheet, { "begin", "A1 insert 10", "A2 delete", "B1 insert 5", "commit" });
+    checkEqual(spreadsheet.getValue(cell("A3")), "10.000000", "Committed sum");
+
+    run(spreadsheet, { "begin", "A1 insert 100", "A2 insert 7", "B1 delete", "C1 insert 1" });
+    check(spreadsheet.getViewModel().isInTransaction(), "The transaction ended with the batch");
+    run(spreadsheet, { "rollback" });
+    checkEqual(spreadsheet.getValue(cell("A1")), "10.000000", "Rolled back A1");
+    checkEqual(spreadsheet.getValue(cell("A2")), "", "Rolled back deletion");
+    checkEqual(spreadsheet.getValue(cell("B1")), "5.000000", "Rolled back B1");
+    check(!spreadsheet.getTableModel().getCellValue(cell("C1")), "Rolled back C1 still exists");
+    checkEqual(spreadsheet.getValue(cell("A3")), "10.000000", "Rolled back sum");
+
+    check(!runFailing(spreadsheet, "commit").empty(), "Commit without begin did not fail");
+    check(!runFailing(spreadsheet, "rollback").empty(), "Rollback without begin did not fail");
+    run(spreadsheet, { "begin" });
+    check(!runFailing(spreadsheet, "begin").empty(), "Nested begin did not fail");
+    check(!runFailing(spreadsheet, "undo").empty(), "Undo inside a transaction did not fail");
+    check(!runFailing(spreadsheet, "addsheet Other").empty(), "Adding a sheet inside a transaction did not fail");
+    run(spreadsheet, { "commit" });
+}
+
+static void testUndoRedo() {
+    Spreadsheet spreadsheet(testConfiguration());
+    run(spreadsheet, { "A1 insert 1", "A2=A1" });
+    run(spreadsheet, { "A1 insert 2" });
+    run(spreadsheet, { "begin", "A1 delete", "B1 insert 3", "commit" });
+
+    run(spreadsheet, { "undo" });
+    checkEqual(spreadsheet.getValue(cell("A2")), "2.000000", "A2 after undoing the transaction");
+    check(!spreadsheet.getTableModel().getCellValue(cell("B1")), "B1 exists after undoing the transaction");
+    run(spreadsheet, { "undo" });
+    checkEqual(spreadsheet.getValue(cell("A2")), "1.000000", "A2 after the second undo");
+    run(spreadsheet, { "redo" });
+    checkEqual(spreadsheet.getValue(cell("A2")), "2.000000", "A2 after redo");
+
+    // A new edit drops what was undone
+    run(spreadsheet, { "A1 insert 5" });
+    check(!runFailing(spreadsheet, "redo").empty(), "Redo after a new edit did not fail");
+    run(spreadsheet, { "undo", "undo", "undo" });
+    check(spreadsheet.getTableModel().getAllCells().empty(), "Cells left after undoing everything");
+    check(!runFailing(spreadsheet, "undo").empty(), "Undo with an empty history did not fail");
+}
+
+static Edit editOf(size_t cells) {
+    Edit edit;
+    edit.reserve(cells);
+    for (size_t column = 0; column < cells; ++column) {
+        edit.push_back(CellDelta{ CellAddress{ 0, column }, std::nullopt, CellValue{ LiteralValue{ 1.0 } } });
+    }
+    return edit;
+}
+
+static void testEditHistoryLimit() {
+    size_t limit = 64 * sizeof(CellDelta);
+    EditHistory history(limit);
+    check(history.record(editOf(10)), "A small edit was not recorded");
+    check(history.record(editOf(20)), "A second small edit was not recorded");
+
+    // An edit above the limit on its own is refused, the earlier ones stay
+    check(!history.record(editOf(100)), "An edit above the limit was recorded");
+    const Edit* undone = history.undo();
+    check(undone && undone->size() == 20, "The latest small edit was not kept");
+    check(!history.record(editOf(100)), "An edit above the limit was recorded after undo");
+    check(!history.redo(), "Redo survived a refused edit");
+
+    // Older edits make room for newer ones
+    check(history.record(editOf(60)), "An edit within the limit was not recorded");
+    check(history.getMemoryUsage() <= limit, "The history grew past its limit");
+    undone = history.undo();
+    check(undone && undone->size() == 60, "The newest edit was dropped");
+    check(!history.undo(), "The oldest edit was kept past the limit");
+}
+
+// - Library API
+
+static void testSpreadsheetApi() {
+    Spreadsheet spreadsheet(testConfiguration());
+    std::vector<Event> events = {
+        EventParser::parse("A1 insert 1"), EventParser::parse("commit"), EventParser::parse("A2 insert 2"),
+        EventParser::parse("A3=SUM(A1:A2)"), EventParser::parse("sheet Missing")
+    };
+    Spreadsheet::BatchResult result = spreadsheet.apply(events.data(), events.size());
+    checkEqual(std::to_string(result.applied), "3", "Applied events");
+    checkEqual(std::to_string(result.errors.size()), "2", "Failed events");
+    checkEqual(std::to_string(result.errors[0].first) + "," + std::to_string(result.errors[1].first), "1,4", "Failed event indices");
+
+    std::vector<CellAddress> addresses = { cell("A3"), cell("B1"), cell("A1") };
+    std::vector<std::string> values(addresses.size(), "stale");
+    checkEqual(std::to_string(spreadsheet.readValues(addresses.data(), addresses.size(), values.data())), "2", "Non-empty values");
+    checkEqual(values[0] + "|" + values[1] + "|" + values[2], "3.000000||1.000000", "Read values");
+
+    values.assign(4, "stale");
+    checkEqual(std::to_string(spreadsheet.readRange(AddressRange{ cell("A1"), cell("B2") }, values.data())), "2", "Non-empty range values");
+    checkEqual(values[0] + "|" + values[1] + "|" + values[2] + "|" + values[3], "1.000000|2.000000||", "Range in row-major order");
+
+    // Saved as a workbook once there is a second sheet, and opened again with both
+    run(spreadsheet, { "addsheet Other", "A1=Sheet1!A3", "sheet Sheet1" });
+    std::string fileName = scratchFile("api.workbook");
+    std::string configFileName = scratchFile("api-config.txt");
+    writeFile(configFileName, "initialTableRows:10\ninitialTableCols:10\nmaxTableRows:100\nmaxTableCols:100\nautoFit:true\n"
+        "visibleCellSymbols:15\ninitialAlignment:left\nclearConsoleAfterCommand:false\n");
+    spreadsheet.save(fileName);
+
+    Spreadsheet reloaded(fileName, configFileName);
+    checkEqual(describe(reloaded.getTableModel()), describe(spreadsheet.getTableModel()), "Reloaded first sheet");
+    run(reloaded, { "sheet Other" });
+    checkEqual(reloaded.getValue(cell("A1")), "3.000000", "Reloaded reference to the first sheet");
+
+    checkThrows([&] { spreadsheet.save(scratchFile("missing/api.workbook")); }, "Saving into a missing directory");
+    checkThrows([&] { Spreadsheet(fileName, scratchFile("missing-config.txt")); }, "Opening with a missing configuration");
+}
+
+static void testSpreadsheetManualCalculation() {
+    TableConfiguration config = testConfiguration();
+    config.calculationMode = CalculationMode::Manual;
+    Spreadsheet spreadsheet(config);
+    run(spreadsheet, { "A1 insert 1", "A2=A1", "calc" });
+    checkEqual(spreadsheet.getValue(cell("A2")), "1.000000", "Calculated value");
+
+    run(spreadsheet, { "A1 insert 2" });
+    check(spreadsheet.getViewModel().isStale(cell("A2")), "A2 is not stale before 'calc'");
+    run(spreadsheet, { "calc" });
+    checkEqual(spreadsheet.getValue(cell("A2")), "2.000000", "Recalculated value");
+}
+
+// - MAIN
+
+struct Test {
+    const char* name;
+    void (*run)();
+};
+
+static const std::vector<Test> tests = {
+    { "csv quoted fields are text", testCsvQuotedFieldsAreText },
+    { "csv raw export round trip", testCsvRawExportRoundTrip },
+    { "csv values export", testCsvValuesExport },
+    { "csv import errors", testCsvImportErrors },
+    { "csv import clears undo", testCsvImportClearsUndo },
+    { "shared formula round trip", testSharedFormulaRoundTrip },
+    { "table file errors", testTableFileErrors },
+    { "snapshot round trip", testSnapshotRoundTrip },
+    { "snapshot corrupt input", testSnapshotCorruptInput },
+    { "fill and paste", testFillAndPaste },
+    { "transactions", testTransactions },
+    { "undo and redo", testUndoRedo },
+    { "edit history limit", testEditHistoryLimit },
+    { "spreadsheet api", testSpreadsheetApi },
+    { "spreadsheet manual calculation", testSpreadsheetManualCalculation },
+};
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        std::string name = argv[i];
+        if (name == "--scratch" && i + 1 < argc) {
+            scratchDirectory = argv[++i];
+        }
+        else {
+            std::cerr << "Unknown option " << name << std::endl;
+            return 2;
+        }
+    }
+
+    int failed = 0;
+    for (const auto& test : tests) {
+        try {
+            test.run();
+            std::cout << "ok      " << test.name << "\n";
+        }
+        catch (const std::exception& e) {
+            ++failed;
+            std::cout << "FAILED  " << test.name << ": " << e.what() << "\n";
+        }
+    }
+    std::cout << tests.size() - failed << " of " << tests.size() << " tests passed\n";
+    return failed;
+}